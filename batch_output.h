@@ -0,0 +1,201 @@
+/*
+Copyright (c) 2019 Advanced Micro Devices, Inc.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+Author: Alex D. Breslow 
+        Advanced Micro Devices, Inc.
+        AMD Research
+
+Code Source: https://github.com/AMDComputeLibraries/morton_filter
+
+VLDB 2018 Paper: https://www.vldb.org/pvldb/vol11/p1041-breslow.pdf
+
+How To Cite:
+  Alex D. Breslow and Nuwan S. Jayasena. Morton Filters: Faster, Space-Efficient
+  Cuckoo Filters Via Biasing, Compression, and Decoupled Logical Sparsity. PVLDB,
+  11(9):1041-1055, 2018
+  DOI: https://doi.org/10.14778/3213880.3213884
+
+*/
+#ifndef _BATCH_OUTPUT_H
+#define _BATCH_OUTPUT_H
+
+// Batched lookups produce the results of each batch as a bitmap with one bit 
+// per key (key i is bit i % 64 of word i / 64).  The lookup front ends hand 
+// those bitmaps to one of the output policies below, which decides how the 
+// results reach the caller.  An output policy only needs a 
+// write(offset, found, count) method, where offset is the index of the 
+// batch's first key in the caller's input and count is the number of valid 
+// keys in the batch.
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#define INLINE __attribute__((always_inline)) inline
+
+namespace CompressedCuckoo{
+  // The bitmaps are std::array<uint64_t, W>, where W depends on the filter's 
+  // batch size, hence the templates.
+  template<size_t W>
+  INLINE void set_batch_bit(std::array<uint64_t, W>& bits, uint64_t i, 
+    bool value){
+    bits[i / 64] |= static_cast<uint64_t>(value) << (i % 64);
+  }
+
+  template<size_t W>
+  INLINE bool get_batch_bit(const std::array<uint64_t, W>& bits, uint64_t i){
+    return (bits[i / 64] >> (i % 64)) & 1;
+  }
+
+  // Mask for the valid bits of word w of a batch with count valid keys
+  INLINE uint64_t batch_word_mask(uint64_t w, uint64_t count){
+    const uint64_t valid_bits = count - w * 64;
+    return valid_bits >= 64 ? ~static_cast<uint64_t>(0) : 
+      (static_cast<uint64_t>(1) << valid_bits) - 1;
+  }
+
+  // Copies bits [offset, offset + 64 * W) of bits into batch.  bits must 
+  // extend at least one word past the last bit that is read.
+  template<size_t W>
+  INLINE void extract_batch_bits(const uint64_t* bits, uint64_t offset, 
+    std::array<uint64_t, W>& batch){
+    const uint64_t shift = offset % 64;
+    bits += offset / 64;
+    for(uint64_t w = 0; w < W; w++){
+      batch[w] = shift ? (bits[w] >> shift) | (bits[w + 1] << (64 - shift)) :
+        bits[w];
+    }
+  }
+
+  // One std::vector<bool> proxy write per key (the original interface)
+  struct StatusVectorOutput{
+    std::vector<bool>& _status;
+    explicit StatusVectorOutput(std::vector<bool>& status) : _status(status){}
+
+    template<size_t W>
+    INLINE void write(uint64_t offset, const std::array<uint64_t, W>& found, 
+      uint64_t count){
+      for(uint64_t i = 0; i < count; i++){
+        _status[offset + i] = get_batch_bit(found, i);
+      }
+    }
+  };
+
+  // Writes into a caller-supplied bitmap of at least (num_keys + 63) / 64 
+  // words with whole-word stores.  Bits past num_keys in the last word are 
+  // zeroed.  Batches arrive in order, so when the batch size isn't a 
+  // multiple of 64, a batch that starts mid-word keeps the bits of the 
+  // preceding batches in that word.
+  struct BitmapOutput{
+    uint64_t* _bitmap;
+    explicit BitmapOutput(uint64_t* bitmap) : _bitmap(bitmap){}
+
+    template<size_t W>
+    INLINE void write(uint64_t offset, const std::array<uint64_t, W>& found, 
+      uint64_t count){
+      uint64_t* words = _bitmap + offset / 64;
+      const uint64_t shift = offset % 64;
+      const uint64_t word_count = (count + 63) / 64;
+      for(uint64_t w = 0; w < word_count; w++){
+        const uint64_t bits = found[w] & batch_word_mask(w, count);
+        if(shift == 0){
+          words[w] = bits;
+          continue;
+        }
+        words[w] = (words[w] & ((static_cast<uint64_t>(1) << shift) - 1)) | 
+          (bits << shift);
+        // Only spill into the next word if some of this word's valid bits 
+        // belong there, so that the bitmap is never written past its end.
+        if(count - w * 64 > 64 - shift){
+          words[w + 1] = bits >> (64 - shift);
+        }
+      }
+    }
+  };
+
+  // Only counts the hits
+  struct CountOutput{
+    uint64_t _count = 0;
+
+    template<size_t W>
+    INLINE void write(uint64_t, const std::array<uint64_t, W>& found, 
+      uint64_t count){
+      const uint64_t word_count = (count + 63) / 64;
+      for(uint64_t w = 0; w < word_count; w++){
+        _count += __builtin_popcountll(found[w] & batch_word_mask(w, count));
+      }
+    }
+  };
+
+  // Writes the input indexes of the keys that were found, in order, to a 
+  // selection vector.  The compaction is branch free: every key's index is 
+  // stored at the current end of the selection vector, and the end only 
+  // advances past it if the key was found.  This means that the selection 
+  // vector needs room for num_keys entries, not just the hits.  Indexes are 
+  // stored as SEL_T, so SEL_T has to be able to hold num_keys - 1 
+  // (select_likely_contained_many checks).
+  template<class SEL_T>
+  struct SelectionOutput{
+    SEL_T* _selection;
+    uint64_t _count = 0;
+    explicit SelectionOutput(SEL_T* selection) : _selection(selection){}
+
+    template<size_t W>
+    INLINE void write(uint64_t offset, const std::array<uint64_t, W>& found, 
+      uint64_t count){
+      uint64_t end = _count;
+      for(uint64_t i = 0; i < count; i++){
+        _selection[end] = static_cast<SEL_T>(offset + i);
+        end += get_batch_bit(found, i);
+      }
+      _count = end;
+    }
+  };
+
+  // Same as SelectionOutput, but also gathers the found keys' rows of a 
+  // payload column into payload_out so that the next operator (e.g., the 
+  // probe side of a hash join) can consume them without going back to the 
+  // selection vector.  payload_out also needs room for num_keys entries.
+  template<class SEL_T, class PAYLOAD_T>
+  struct SelectionGatherOutput{
+    SEL_T* _selection;
+    const PAYLOAD_T* _payload;
+    PAYLOAD_T* _payload_out;
+    uint64_t _count = 0;
+    SelectionGatherOutput(SEL_T* selection, const PAYLOAD_T* payload, 
+      PAYLOAD_T* payload_out) : _selection(selection), _payload(payload), 
+      _payload_out(payload_out){}
+
+    template<size_t W>
+    INLINE void write(uint64_t offset, const std::array<uint64_t, W>& found, 
+      uint64_t count){
+      uint64_t end = _count;
+      for(uint64_t i = 0; i < count; i++){
+        _selection[end] = static_cast<SEL_T>(offset + i);
+        _payload_out[end] = _payload[offset + i];
+        end += get_batch_bit(found, i);
+      }
+      _count = end;
+    }
+  };
+}
+
+#endif // End of file guards
@@ -47,18 +47,6 @@ constexpr uint64_t round_to_appropriate_size(uint64_t desired_size){
   return desired_size + (batch_size - desired_size % batch_size);
 }
 
-// A variant of equation (5) in the VLDB'18 paper
-template<class MF_CLASS>
-double calculate_mf_false_positive_ratio(MF_CLASS& mf, double ota_occupancy, 
-  double logical_load_factor){
-  double buckets_accessed_per_negative_lookup = 1 + ota_occupancy;
-  double epsilon = 1.0 - pow(1.0 - 1.0/(1ULL << (mf._fingerprint_len_bits - 
-    mf._resize_count)), 
-    logical_load_factor * buckets_accessed_per_negative_lookup * 
-    mf._slots_per_bucket);
-  return epsilon;
-}
-
 void benchmark(){
   constexpr bool use_item_at_a_time_insertion = false;
   constexpr bool use_item_at_a_time_deletion = false;
@@ -203,8 +191,10 @@ void benchmark(){
     std::endl;
   double block_occupancy = ccf.report_block_occupancy();
   std::cout << "Projected False Positive Ratio: " << 
-    calculate_mf_false_positive_ratio<MortonFilter>(ccf, ota_occupancy, 
+    ccf.false_positive_ratio(ota_occupancy, 
     block_occupancy * ccf.report_compression_ratio()) << std::endl;
+  std::cout << "Estimated False Positive Ratio (from counters): " << 
+    ccf.estimated_fpr() << std::endl;
   std::cout << "Block occupancy: " << block_occupancy << std::endl;
   if(print_load_histogram) ccf.print_bucket_and_block_load_histograms();
   
@@ -75,6 +75,49 @@ int main(int argc, char** argv){
     }
   }
 
+  // Lookups of a batch of keys that is large enough for radix partitioning 
+  // to pay off (one key per 4 slots), with and without partitioning
+  constexpr uint64_t large_lookup_count = total_slots / 4;
+  std::cout << "FILTER  LOAD  OPERATION  THROUGHPUT %%TRUE_POSITIVE\n";
+  for(double lf : {0.50, 0.95}){
+    for(bool partitioned : {false, true}){
+      double throughput = 0.0;
+      for(uint64_t t = 0; t < lookup_trials; t++){
+        trial_outputs[t] = benchmark_lookups<fingerprint_len_bits>(
+          total_slots, lf, 0.0, large_lookup_count, partitioned);
+        throughput += trial_outputs[t];
+      }
+      std::cout << "MF  " << lf << (partitioned ? " LOOKUP_PARTITIONED " : 
+        " LOOKUP_LARGE ") << throughput / lookup_trials << " " << 0.0;
+      for(uint64_t t = 0; t < lookup_trials; t++){
+        std::cout << " " << trial_outputs[t];
+      }
+      std::cout << std::endl;
+    }
+  }
+
+  // Negative lookups with prefilters of 1/32, 1/8, and 1/2 of a byte per 
+  // slot in front of the table.  TABLE_BYTES_SAVED is per negative lookup.
+  std::cout << "FILTER  LOAD  PREFILTER_BYTES  OPERATION  THROUGHPUT  "
+    "REJECTED  TABLE_BYTES_SAVED\n";
+  for(double lf : {0.50, 0.95}){
+    for(uint64_t prefilter_bytes : {static_cast<uint64_t>(0), 
+      total_slots / 32, total_slots / 8, total_slots / 2}){
+      double throughput = 0.0, rejected = 0.0, bytes_saved = 0.0;
+      for(uint64_t t = 0; t < lookup_trials; t++){
+        double trial_rejected, trial_bytes_saved;
+        throughput += benchmark_prefiltered_lookups<fingerprint_len_bits>(
+          total_slots, lf, prefilter_bytes, trial_rejected, trial_bytes_saved);
+        rejected += trial_rejected;
+        bytes_saved += trial_bytes_saved;
+      }
+      std::cout << "MF  " << lf << " " << prefilter_bytes << 
+        " LOOKUP_PREFILTERED " << throughput / lookup_trials << " " << 
+        rejected / lookup_trials << " " << bytes_saved / lookup_trials << 
+        std::endl;
+    }
+  }
+
   // Insertions
   std::vector<double> insert_throughputs(lfs.size(), 0.0);
   std::cout << "FILTER  LOAD  OPERATION  THROUGHPUT\n";
@@ -93,6 +136,21 @@ int main(int argc, char** argv){
     std::cout << std::endl;
   }
 
+  // Building a filter from scratch key at a time (insert_many) and block at a
+  // time (bulk_load)
+  std::cout << "FILTER  LOAD  OPERATION  THROUGHPUT\n";
+  for(double lf : {0.80, 0.95}){
+    for(bool bulk : {false, true}){
+      double throughput = 0.0;
+      for(uint64_t t = 0; t < modify_trials; t++){
+        throughput += benchmark_builds<fingerprint_len_bits>(total_slots, lf, 
+          bulk);
+      }
+      std::cout << "MF  " << lf << (bulk ? " BUILD_BULK " : " BUILD ") << 
+        throughput / modify_trials << std::endl;
+    }
+  }
+
   // Deletions
   std::vector<double> delete_throughputs(lfs.size());
   std::cout << "FILTER  LOAD  OPERATION  THROUGHPUT\n";
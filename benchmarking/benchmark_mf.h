@@ -44,7 +44,8 @@ How To Cite:
 #include "benchmark_common.h" // slot_fraction and TBD other parameters
 
 using namespace Benchmark;
-using Morton_Type = CompressedCuckoo::CompressedCuckooFilter<
+template<uint64_t t_batch_size = batch_size>
+using Morton_Type_Batched = CompressedCuckoo::CompressedCuckooFilter<
     bench_mf::slots_per_bucket,
     bench_mf::fingerprint_len_bits,
     bench_mf::ota_len_bits,
@@ -61,8 +62,10 @@ using Morton_Type = CompressedCuckoo::CompressedCuckooFilter<
     bench_mf::morton_filter_functionality_enabled, 
     bench_mf::block_fullness_array_enabled, // Block fullness array enabled
     bench_mf::handle_conflicts,  // Handle conflicts on insertions enabled
-    bench_mf::fingerprint_comparison_method  
+    bench_mf::fingerprint_comparison_method,
+    t_batch_size
   >;
+using Morton_Type = Morton_Type_Batched<>;
 
 template<uint64_t fingerprint_len_bits>
 double benchmark_insertions(uint64_t total_slots, double target_lf){
@@ -102,6 +105,36 @@ double benchmark_insertions(uint64_t total_slots, double target_lf){
   return secondary_insert_count / (diff.count() * 1e6);
 }
 
+// Throughput in millions of keys per second of filling an empty filter to 
+// the target load factor, either with insert_many or with bulk_load using 
+// all of the hardware threads
+template<uint64_t fingerprint_len_bits>
+double benchmark_builds(uint64_t total_slots, double target_lf, bool bulk){
+  Morton_Type cf(total_slots);
+  uint64_t items_to_insert_to_hit_lf_target = 
+    to_multiple_of_batch(target_lf * total_slots, batch_size);
+  std::vector<keys_t> insert_items(items_to_insert_to_hit_lf_target);
+  populate_with_random_numbers<keys_t>(insert_items);
+  std::vector<bool> status(items_to_insert_to_hit_lf_target, false);
+
+  time_point start = now();
+  if(bulk){
+    cf.bulk_load(insert_items.data(), items_to_insert_to_hit_lf_target, 
+      status);
+  }
+  else{
+    cf.insert_many(insert_items, status, items_to_insert_to_hit_lf_target);
+  }
+  std::chrono::duration<double> diff = std::chrono::duration_cast<std::chrono::duration<double>>(now() - start);
+
+  uint64_t success_count = std::accumulate(status.begin(), status.end(), 0);
+  if(success_count != items_to_insert_to_hit_lf_target){
+    std::cerr << "Only " << success_count << " of " << 
+      items_to_insert_to_hit_lf_target << " insertions succeeded.\n";
+  }
+  return items_to_insert_to_hit_lf_target / (diff.count() * 1e6);
+}
+
 template<uint64_t fingerprint_len_bits>
 double benchmark_deletions(uint64_t total_slots, double target_lf){
   Morton_Type cf(total_slots);
@@ -138,14 +171,17 @@ double benchmark_deletions(uint64_t total_slots, double target_lf){
   return delete_count / (diff.count() * 1e6);
 }
 
-template<uint64_t fingerprint_len_bits>
+// With partitioned set, the lookups go through 
+// likely_contains_many_partitioned instead of likely_contains_many.
+template<uint64_t fingerprint_len_bits, uint64_t t_batch_size = batch_size>
 double benchmark_lookups(uint64_t total_slots, double target_lf, 
-  double overlap){
-  Morton_Type cf(total_slots);
+  double overlap, uint64_t lookup_count = 1024 * 1024, 
+  bool partitioned = false){
+  Morton_Type_Batched<t_batch_size> cf(total_slots);
 
   // Look a number of keys equal to 0.1% (when slot_fraction is 0.001)
   // of the total slots in the table (configuration from VLDB'18 paper)
-  uint64_t lookup_count = 1024 * 1024; //to_multiple_of_batch(total_slots * slot_fraction, 
+  //lookup_count = to_multiple_of_batch(total_slots * slot_fraction, 
     //batch_size);
 
   uint64_t items_to_insert_to_hit_lf_target = 
@@ -163,7 +199,13 @@ double benchmark_lookups(uint64_t total_slots, double target_lf,
   cf.insert_many(insert_items, status, items_to_insert_to_hit_lf_target); 
  
   time_point start = now();
-  cf.likely_contains_many(probe_items, status_benchmark, lookup_count);
+  if(partitioned){
+    cf.likely_contains_many_partitioned(probe_items, status_benchmark, 
+      lookup_count);
+  }
+  else{
+    cf.likely_contains_many(probe_items, status_benchmark, lookup_count);
+  }
   std::chrono::duration<double> diff = 
     std::chrono::duration_cast<std::chrono::duration<double>>(now() - start);
 
@@ -177,4 +219,48 @@ double benchmark_lookups(uint64_t total_slots, double target_lf,
   return lookup_count / (diff.count() * 1e6);
 }
 
+// Negative lookups with the prefilter in front of the table (none if 
+// prefilter_bytes is 0).  Sets rejected_fraction to the fraction of the 
+// lookups that the prefilter answered and table_bytes_saved to the bytes of
+// blocks that those lookups didn't read, per negative lookup.  Without the 
+// prefilter, a negative lookup reads its primary block and, if its OTA bit is
+// set (or always for compressed cuckoo filters), its secondary block.
+template<uint64_t fingerprint_len_bits>
+double benchmark_prefiltered_lookups(uint64_t total_slots, double target_lf,
+  uint64_t prefilter_bytes, double& rejected_fraction, 
+  double& table_bytes_saved, uint64_t lookup_count = 1024 * 1024){
+  Morton_Type cf(total_slots);
+
+  uint64_t items_to_insert_to_hit_lf_target = 
+    to_multiple_of_batch(target_lf * total_slots, batch_size);
+
+  std::vector<keys_t> insert_items(items_to_insert_to_hit_lf_target);
+  std::vector<keys_t> probe_items(lookup_count);
+
+  populate_with_random_numbers<keys_t>(insert_items, probe_items, 0.0, 1);
+
+  std::vector<bool> status(items_to_insert_to_hit_lf_target, false);
+  std::vector<bool> status_benchmark(lookup_count, false);
+ 
+  cf.insert_many(insert_items, status, items_to_insert_to_hit_lf_target); 
+  if(prefilter_bytes){
+    cf.enable_prefilter(prefilter_bytes);
+  }
+ 
+  time_point start = now();
+  cf.likely_contains_many(probe_items, status_benchmark, lookup_count);
+  std::chrono::duration<double> diff = 
+    std::chrono::duration_cast<std::chrono::duration<double>>(now() - start);
+
+  rejected_fraction = prefilter_bytes ? 
+    static_cast<double>(cf.prefilter_rejections()) / cf.prefilter_lookups() :
+    0.0;
+  const double blocks_per_negative = 
+    Morton_Type::_morton_filter_functionality_enabled ? 
+    1.0 + cf.ota_saturation() : 2.0;
+  table_bytes_saved = rejected_fraction * blocks_per_negative * 
+    (bench_mf::block_size_bits / 8);
+  return lookup_count / (diff.count() * 1e6);
+}
+
 #endif
@@ -0,0 +1,78 @@
+/*
+Copyright (c) 2019 Advanced Micro Devices, Inc.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+Author: Alex D. Breslow 
+        Advanced Micro Devices, Inc.
+        AMD Research
+
+Code Source: https://github.com/AMDComputeLibraries/morton_filter
+
+VLDB 2018 Paper: https://www.vldb.org/pvldb/vol11/p1041-breslow.pdf
+
+How To Cite:
+  Alex D. Breslow and Nuwan S. Jayasena. Morton Filters: Faster, Space-Efficient
+  Cuckoo Filters Via Biasing, Compression, and Decoupled Logical Sparsity. PVLDB,
+  11(9):1041-1055, 2018
+  DOI: https://doi.org/10.14778/3213880.3213884
+
+*/
+// Lookup throughput as a function of the batch size (t_batch_size).  Every 
+// batch size is a separate instantiation of the whole filter, so the sweep 
+// lives in its own program (make batch_size_sweep) rather than in 
+// benchmark_mf, where the extra code would push the hot insertion and lookup 
+// paths past GCC's inlining limits.
+#include "benchmark_mf.h"
+
+
+using namespace Benchmark;
+
+template<uint64_t fingerprint_len_bits>
+void benchmark_batch_size_sweep(uint64_t, double, uint64_t){}
+
+// Benchmarks lookups once per batch size in t_batch_sizes
+template<uint64_t fingerprint_len_bits, uint64_t t_batch_size, 
+  uint64_t... t_batch_sizes>
+void benchmark_batch_size_sweep(uint64_t total_slots, double lf, 
+  uint64_t trials){
+  double throughput = 0.0;
+  for(uint64_t t = 0; t < trials; t++){
+    throughput += benchmark_lookups<fingerprint_len_bits, t_batch_size>(
+      total_slots, lf, 0.0);
+  }
+  std::cout << "MF  " << total_slots << " " << t_batch_size << " LOOKUP " << 
+    throughput / trials << std::endl;
+  benchmark_batch_size_sweep<fingerprint_len_bits, t_batch_sizes...>(
+    total_slots, lf, trials);
+}
+
+int main(int argc, char** argv){
+  constexpr uint64_t fingerprint_len_bits = bench_mf::fingerprint_len_bits;
+  constexpr uint64_t total_slots = 128 * 1024 * 1024;
+  constexpr uint64_t lookup_trials = 5; // Multiple trials also achieved with benchmark.sh
+
+  // Lookup throughput as a function of the batch size at two filter sizes
+  std::cout << "FILTER  SLOTS  BATCH_SIZE  OPERATION  THROUGHPUT\n";
+  for(uint64_t slots : {total_slots / 128, total_slots}){
+    benchmark_batch_size_sweep<fingerprint_len_bits, 32, 64, 128, 256, 512>(
+      slots, 0.95, lookup_trials);
+  }
+  return 0;
+}
@@ -0,0 +1,448 @@
+/*
+Copyright (c) 2019 Advanced Micro Devices, Inc.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+Author: Alex D. Breslow 
+        Advanced Micro Devices, Inc.
+        AMD Research
+
+Code Source: https://github.com/AMDComputeLibraries/morton_filter
+
+VLDB 2018 Paper: https://www.vldb.org/pvldb/vol11/p1041-breslow.pdf
+
+How To Cite:
+  Alex D. Breslow and Nuwan S. Jayasena. Morton Filters: Faster, Space-Efficient
+  Cuckoo Filters Via Biasing, Compression, and Decoupled Logical Sparsity. PVLDB,
+  11(9):1041-1055, 2018
+  DOI: https://doi.org/10.14778/3213880.3213884
+
+*/
+// Regression check for false negatives.  It fills filters past the point 
+// where the cuckoo path search gives up, so that some items end up in the 
+// overflow stash, using insert_many, insert, bulk_load on one thread, the 
+// bulk-loading constructor on four threads, and insert_many on a 32-bit 
+// KeyColumn with nulls, and then looks up every item that was reported as 
+// stored with each of the lookup APIs.  A filter must never 
+// report a stored item as absent, so any miss is a bug.  It then deletes 
+// half of the items through a KeyColumn and checks that the deletions 
+// succeeded and that the other half is still there.  Last, it checks that 
+// the hot-key cache never turns a stored key into a miss or keeps a deleted 
+// key's hit around.  Build and run it with `make check`.
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "morton_filter.h"
+#include "test_util.h"
+
+using namespace CompressedCuckoo;
+
+// A compressed cuckoo filter (no OTA, so lookups always check both buckets)
+// to go along with the Morton filter configurations
+constexpr SerializedFixedPoint target_compression_ratio_sfp_ccf_3_8 = 
+  FixedPoint(0.25).serialize();
+typedef CompressedCuckooFilter<3, 8, 0, 512, 
+  target_compression_ratio_sfp_ccf_3_8,
+  CounterReadMethodEnum::READ_SIMPLE, FingerprintReadMethodEnum::READ_SIMPLE,
+  ReductionMethodEnum::POP_CNT, 
+  AlternateBucketSelectionMethodEnum::FUNCTION_BASED_OFFSET,
+  OverflowTrackingArrayHashingMethodEnum::CLUSTERED_BUCKET_HASH, false, true, 
+  true, false, false, true, FingerprintComparisonMethodEnum::VARIABLE_COUNT> 
+  CompressedCuckoo3_8;
+
+// Morton3_8 with a 1024-entry hot-key cache
+typedef CompressedCuckooFilter<3, 8, 16, 512, target_compression_ratio_sfp_3_8,
+  CounterReadMethodEnum::READ_SIMPLE, FingerprintReadMethodEnum::READ_SIMPLE,
+  ReductionMethodEnum::POP_CNT, 
+  AlternateBucketSelectionMethodEnum::FUNCTION_BASED_OFFSET, 
+  OverflowTrackingArrayHashingMethodEnum::CLUSTERED_BUCKET_HASH, 
+  resizing_enabled, true, true, true, false, true, 
+  FingerprintComparisonMethodEnum::VARIABLE_COUNT, batch_size, 1024> 
+  Morton3_8HotKeyCache;
+
+enum struct InsertAPI{INSERT_MANY, INSERT, BULK_LOAD, BULK_LOAD_PARALLEL, 
+  COLUMN};
+
+static uint64_t g_failures = 0;
+
+static void report(const std::string& what, uint64_t false_negatives){
+  if(false_negatives != 0){
+    std::cout << "  " << what << ": " << false_negatives << 
+      " false negatives\n";
+    g_failures++;
+  }
+}
+
+static uint64_t count_misses(const std::vector<bool>& status, uint64_t n){
+  uint64_t misses = 0;
+  for(uint64_t i = 0; i < n; i++){
+    misses += !status[i];
+  }
+  return misses;
+}
+
+static void check_true(const std::string& what, bool condition){
+  if(!condition){
+    std::cout << "  " << what << " is wrong\n";
+    g_failures++;
+  }
+}
+
+static uint64_t count_bitmap_misses(const std::vector<uint64_t>& bitmap, 
+  uint64_t n){
+  uint64_t misses = 0;
+  for(uint64_t i = 0; i < n; i++){
+    misses += !((bitmap[i / 64] >> (i % 64)) & 1);
+  }
+  return misses;
+}
+
+// Looks up every key in keys, all of which were stored, with each lookup API
+template<class FILTER>
+void check_lookups(FILTER& mf, const std::vector<keys_t>& keys){
+  const uint64_t n = keys.size();
+  std::vector<bool> status(n);
+  std::vector<uint64_t> bitmap((n + 63) / 64);
+
+  uint64_t misses = 0;
+  for(keys_t key : keys){
+    misses += !mf.likely_contains(key);
+  }
+  report("likely_contains", misses);
+
+  mf.likely_contains_many(keys, status, n);
+  report("likely_contains_many", count_misses(status, n));
+  mf.likely_contains_many(keys, bitmap.data(), n);
+  report("likely_contains_many (bitmap)", count_bitmap_misses(bitmap, n));
+  report("count_likely_contained_many", 
+    n - mf.count_likely_contained_many(keys, n));
+  std::vector<uint32_t> selection(n);
+  report("select_likely_contained_many", 
+    n - mf.select_likely_contained_many(keys, selection.data(), n));
+
+  mf.likely_contains_many_partitioned(keys, status, n);
+  report("likely_contains_many_partitioned", count_misses(status, n));
+
+  typename FILTER::LookupHandle handle;
+  mf.prefetch_many(keys, n, handle);
+  mf.resolve_many(handle, status);
+  report("prefetch_many/resolve_many", count_misses(status, n));
+
+  // Dense, strided, and nullable columns
+  mf.likely_contains_many(KeyColumn::dense(keys.data(), n), status);
+  report("likely_contains_many (dense column)", count_misses(status, n));
+  struct Row{
+    uint32_t payload;
+    keys_t key;
+  };
+  std::vector<Row> rows(n);
+  for(uint64_t i = 0; i < n; i++){
+    rows[i].key = keys[i];
+  }
+  mf.likely_contains_many(KeyColumn(&rows[0].key, n, sizeof(Row), 
+    sizeof(keys_t)), status);
+  report("likely_contains_many (strided column)", count_misses(status, n));
+  std::vector<uint8_t> validity((n + 7) / 8, 0);
+  for(uint64_t i = 0; i < n; i += 3){ // Every third row isn't null
+    validity[i / 8] |= 1 << (i % 8);
+  }
+  mf.likely_contains_many(KeyColumn::dense(keys.data(), n, validity.data()),
+    status);
+  misses = 0;
+  for(uint64_t i = 0; i < n; i += 3){
+    misses += !status[i];
+  }
+  report("likely_contains_many (nullable column)", misses);
+
+  misses = 0;
+  auto on_complete = [&](uint64_t tag, bool found){ misses += !found; };
+  InterleavedLookupEngine<FILTER> engine(mf);
+  for(uint64_t i = 0; i < n; i++){
+    engine.submit(keys[i], i, on_complete);
+  }
+  engine.flush(on_complete);
+  report("InterleavedLookupEngine", misses);
+
+  mf.enable_prefilter();
+  misses = 0;
+  for(keys_t key : keys){
+    misses += !mf.likely_contains(key);
+  }
+  report("likely_contains (prefiltered)", misses);
+  mf.likely_contains_many(keys, status, n);
+  report("likely_contains_many (prefiltered)", count_misses(status, n));
+  mf.disable_prefilter();
+}
+
+// Deletes the even-numbered keys, all of which were stored, with 
+// delete_many on a KeyColumn whose odd rows are null.  The column is 32 
+// bits wide if narrow is set (the keys must then fit) and is a strided 
+// column of keys_t otherwise.
+template<class FILTER>
+void check_column_deletes(FILTER& mf, const std::vector<keys_t>& keys, 
+  bool narrow){
+  const uint64_t n = keys.size();
+  std::vector<uint8_t> validity((n + 7) / 8, 0);
+  for(uint64_t i = 0; i < n; i += 2){
+    validity[i / 8] |= 1 << (i % 8);
+  }
+  std::vector<uint32_t> narrow_keys(keys.begin(), keys.end());
+  struct Row{
+    uint32_t payload;
+    keys_t key;
+  };
+  std::vector<Row> rows(n);
+  for(uint64_t i = 0; i < n; i++){
+    rows[i].key = keys[i];
+  }
+  std::vector<bool> status(n);
+  mf.delete_many(narrow ? KeyColumn::dense(narrow_keys.data(), n, 
+    validity.data()) : KeyColumn(&rows[0].key, n, sizeof(Row), 
+    sizeof(keys_t), validity.data()), status);
+  uint64_t failed_deletions = 0;
+  uint64_t deleted_null_rows = 0;
+  std::vector<keys_t> kept;
+  for(uint64_t i = 0; i < n; i++){
+    if(i % 2 == 0){
+      failed_deletions += !status[i];
+    }
+    else{
+      deleted_null_rows += status[i];
+      kept.push_back(keys[i]);
+    }
+  }
+  report("delete_many (column)", failed_deletions);
+  check_true("delete_many (column)'s status of null rows", 
+    deleted_null_rows == 0);
+  check_true("size() after delete_many (column)", mf.size() == kept.size());
+  mf.likely_contains_many(kept, status, kept.size());
+  report("likely_contains_many after delete_many (column)", 
+    count_misses(status, kept.size()));
+}
+
+template<class FILTER>
+void check_filter(const std::string& name, uint64_t total_slots, 
+  double load_factor, InsertAPI insert_api){
+  const uint64_t n = total_slots * load_factor;
+  const bool narrow = insert_api == InsertAPI::COLUMN;
+  std::mt19937_64 rng(n + static_cast<uint64_t>(insert_api));
+  std::vector<keys_t> keys(n);
+  for(keys_t& key : keys){
+    key = narrow ? static_cast<uint32_t>(rng()) : rng();
+  }
+  // The column has a null row every 16 rows, and it has more rows than the 
+  // filter has slots so that it still fills the filter.
+  const uint64_t column_rows = n + n / 15 + 16;
+  std::vector<uint32_t> column_keys(narrow ? column_rows : 0);
+  std::vector<uint8_t> validity(narrow ? (column_rows + 7) / 8 : 0, 0);
+  for(uint64_t r = 0, i = 0; r < column_keys.size(); r++){
+    if(r % 16 != 15 && i < n){
+      column_keys[r] = keys[i++];
+      validity[r / 8] |= 1 << (r % 8);
+    }
+    else{
+      column_keys[r] = static_cast<uint32_t>(rng()); // Never inserted
+    }
+  }
+  std::vector<bool> status(narrow ? column_rows : n);
+  bool all_stored = true;
+  // At full load, the filter complains about every item that it can't 
+  // place once the stash is full.  Those items are expected and skipped.
+  std::cerr.setstate(std::ios::failbit);
+  std::unique_ptr<FILTER> mf_ptr(insert_api == InsertAPI::BULK_LOAD_PARALLEL ?
+    new FILTER(total_slots, keys.data(), n, status, 4) : 
+    new FILTER(total_slots));
+  FILTER& mf = *mf_ptr;
+  switch(insert_api){
+    case InsertAPI::INSERT_MANY:
+      all_stored = mf.insert_many(keys, status, n);
+      break;
+    case InsertAPI::INSERT:
+      for(uint64_t i = 0; i < n; i++){
+        status[i] = mf.insert(keys[i]);
+        all_stored &= status[i];
+      }
+      break;
+    case InsertAPI::BULK_LOAD:
+      all_stored = mf.bulk_load(keys.data(), n, status, 1);
+      break;
+    case InsertAPI::BULK_LOAD_PARALLEL:
+      all_stored = mf.size() == n;
+      break;
+    case InsertAPI::COLUMN:
+      all_stored = mf.insert_many(KeyColumn::dense(column_keys.data(), 
+        column_rows, validity.data()), status);
+      break;
+  }
+  std::cerr.clear();
+  std::vector<keys_t> stored;
+  uint64_t stored_null_rows = 0;
+  for(uint64_t i = 0; i < status.size(); i++){
+    if(narrow && !((validity[i / 8] >> (i % 8)) & 1)){
+      stored_null_rows += status[i];
+    }
+    else if(status[i]){
+      stored.push_back(narrow ? column_keys[i] : keys[i]);
+    }
+  }
+  const char* api_names[] = {"insert_many", "insert", "bulk_load", 
+    "the bulk-loading constructor (4 threads)", "insert_many (32-bit column)"};
+  std::cout << name << " at load " << load_factor << " via " << 
+    api_names[static_cast<int>(insert_api)] << ": " << stored.size() << 
+    " of " << n << " stored, " << mf.stash_size() << " stashed\n";
+  const uint64_t failures_before = g_failures;
+  check_true("The status of null rows", stored_null_rows == 0);
+  check_true("The return value", all_stored == (stored.size() == n));
+  check_true("size()", mf.size() == stored.size());
+  check_lookups(mf, stored);
+  check_column_deletes(mf, stored, narrow);
+  std::cout << "  " << Test::pass(g_failures == failures_before) << "\n";
+}
+
+template<class FILTER>
+void check_filter(const std::string& name, uint64_t total_slots){
+  for(double load_factor : {0.995, 1.0}){
+    for(InsertAPI insert_api : {InsertAPI::INSERT_MANY, InsertAPI::INSERT, 
+      InsertAPI::BULK_LOAD, InsertAPI::BULK_LOAD_PARALLEL, InsertAPI::COLUMN}){
+      check_filter<FILTER>(name, total_slots, load_factor, insert_api);
+    }
+  }
+}
+
+// Looks up the hot keys, each several times, with likely_contains and 
+// likely_contains_many, which use the hot-key cache, and compares the 
+// results with prefetch_many/resolve_many, which don't.  A stored 
+// key must be found, and the cache must not report a key that the table 
+// doesn't have, e.g., one that was deleted after its hit was cached.
+template<class FILTER>
+void check_hot_key_lookups(FILTER& mf, const std::vector<keys_t>& hot_keys, 
+  const std::vector<bool>& stored, const std::string& when){
+  constexpr uint64_t repeats = 4;
+  std::vector<keys_t> keys;
+  for(uint64_t r = 0; r < repeats; r++){
+    keys.insert(keys.end(), hot_keys.begin(), hot_keys.end());
+  }
+  const uint64_t n = keys.size();
+  // likely_contains_many_partitioned won't do as the reference because it 
+  // falls back to likely_contains_many for this few keys
+  std::vector<bool> table_status(n);
+  typename FILTER::LookupHandle handle;
+  mf.prefetch_many(keys, n, handle);
+  mf.resolve_many(handle, table_status);
+  std::vector<bool> status(n);
+  mf.likely_contains_many(keys, status, n);
+  uint64_t misses = 0;
+  uint64_t stale_hits = 0;
+  for(uint64_t i = 0; i < n; i++){
+    const bool scalar = mf.likely_contains(keys[i]);
+    misses += stored[i % hot_keys.size()] && !(status[i] && scalar);
+    stale_hits += (status[i] || scalar) && !table_status[i];
+  }
+  report("hot-key cache " + when, misses);
+  if(stale_hits != 0){
+    std::cout << "  hot-key cache " << when << ": " << stale_hits << 
+      " stale hits\n";
+    g_failures++;
+  }
+}
+
+// Fills a filter with a hot-key cache, looks up a set of hot keys (half of 
+// them stored) over and over, and deletes and reinserts some of the stored 
+// ones in between with each of the batch and single-key APIs.
+template<class FILTER>
+void check_hot_key_cache(const std::string& name, uint64_t total_slots){
+  const uint64_t n = total_slots * 0.9;
+  constexpr uint64_t num_hot_keys = 1000;
+  std::mt19937_64 rng(n);
+  std::vector<keys_t> keys(n);
+  for(keys_t& key : keys){
+    key = rng();
+  }
+  FILTER mf(total_slots);
+  std::vector<bool> status(n);
+  mf.insert_many(keys, status, n);
+  // Even hot keys are stored keys, and odd ones are keys that aren't
+  std::vector<keys_t> hot_keys(num_hot_keys);
+  std::vector<bool> stored(num_hot_keys);
+  for(uint64_t i = 0; i < num_hot_keys; i++){
+    hot_keys[i] = i % 2 == 0 ? keys[i / 2] : rng();
+    stored[i] = i % 2 == 0 && status[i / 2];
+  }
+  std::cout << name << " with a hot-key cache\n";
+  const uint64_t failures_before = g_failures;
+  check_hot_key_lookups(mf, hot_keys, stored, "after insert_many");
+  for(uint64_t round = 0; round < 4; round++){
+    // Deletes a quarter of the stored hot keys, every other one with 
+    // delete_many and the rest with delete_item
+    std::vector<keys_t> batch;
+    for(uint64_t i = round % 2 * 2; i < num_hot_keys; i += 8){
+      if(stored[i]){
+        batch.push_back(hot_keys[i]);
+        stored[i] = false;
+      }
+    }
+    std::vector<bool> batch_status(batch.size());
+    mf.delete_many(batch.begin(), batch.end(), batch_status);
+    uint64_t failed = count_misses(batch_status, batch.size());
+    for(uint64_t i = round % 2 * 2 + 4; i < num_hot_keys; i += 8){
+      if(stored[i]){
+        failed += !mf.delete_item(hot_keys[i]);
+        stored[i] = false;
+      }
+    }
+    report("deletions of hot keys", failed);
+    check_hot_key_lookups(mf, hot_keys, stored, "after deletions");
+    // Puts back the ones that the previous round deleted
+    if(round > 0){
+      batch.clear();
+      const uint64_t first = (round - 1) % 2 * 2;
+      for(uint64_t i = first; i < num_hot_keys; i += 8){
+        batch.push_back(hot_keys[i]);
+      }
+      batch_status.resize(batch.size());
+      mf.insert_many(batch.begin(), batch.end(), batch_status);
+      for(uint64_t i = first, j = 0; i < num_hot_keys; i += 8, j++){
+        stored[i] = batch_status[j];
+      }
+      for(uint64_t i = first + 4; i < num_hot_keys; i += 8){
+        stored[i] = mf.insert(hot_keys[i]);
+      }
+      check_hot_key_lookups(mf, hot_keys, stored, "after reinsertions");
+    }
+  }
+  if(mf.hot_key_cache_hits() == 0){
+    std::cout << "  The hot-key cache was never hit\n";
+    g_failures++;
+  }
+  std::cout << "  " << Test::pass(g_failures == failures_before) << "\n";
+}
+
+int main(int argc, char** argv){
+  constexpr uint64_t total_slots = 1ULL << 20;
+  check_filter<Morton3_8>("Morton3_8", total_slots);
+  check_filter<Morton7_8>("Morton7_8", total_slots);
+  check_filter<CompressedCuckoo3_8>("CompressedCuckoo3_8", total_slots);
+  check_hot_key_cache<Morton3_8HotKeyCache>("Morton3_8", total_slots);
+  std::cout << (g_failures ? "FAILURE" : "SUCCESS") << ": " << g_failures << 
+    " checks failed\n";
+  return g_failures != 0;
+}
@@ -43,7 +43,12 @@ How To Cite:
 // Putze et al. in JEA'09 
 // URL: https://dl.acm.org/citation.cfm?id=1594230
 
+#include <algorithm>
 #include <array>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
 
 namespace BlockedBF{
   using slot_type = uint32_t;
@@ -84,6 +89,84 @@ namespace BlockedBF{
       return conflict_present;
     }
   };
+
+  // A runtime-sized version of the same idea for the optional front tier of 
+  // the filter (see enable_prefilter in compressed_cuckoo_filter.h).  Each 
+  // item sets t_num_hash_fcns bits within one cache line, so every query 
+  // touches at most one line.  Each bit takes 9 bits of the hash (3 to pick 
+  // the word, 6 to pick the bit) and the line comes from the upper 32 bits, 
+  // so t_num_hash_fcns can't be more than 3.  Unlike the conflict detector 
+  // above, it's meant to be much bigger than the L1, but small enough to 
+  // stay in the L2 or L3.
+  template<uint64_t t_num_hash_fcns = 3>
+  class CacheLineBloomFilter{
+    static_assert(t_num_hash_fcns * 9 <= 32, "Too many hash functions");
+    constexpr static uint64_t _words_per_line = 8;
+    struct FreeDeleter{
+      void operator()(uint64_t* p) const{ free(p); }
+    };
+    std::unique_ptr<uint64_t, FreeDeleter> _words;
+    uint64_t _num_lines = 0;
+
+  public:
+    inline void allocate(uint64_t size_bytes){
+      _num_lines = std::max<uint64_t>(1, size_bytes / 
+        (_words_per_line * sizeof(uint64_t)));
+      const uint64_t bytes = _num_lines * _words_per_line * sizeof(uint64_t);
+      _words.reset(static_cast<uint64_t*>(aligned_alloc(
+        _words_per_line * sizeof(uint64_t), bytes)));
+      if(_words == nullptr){
+        std::cerr << "ERROR: Allocating the Bloom filter failed\n";
+        exit(1);
+      }
+      clear();
+    }
+
+    inline void release(){
+      _words.reset();
+      _num_lines = 0;
+    }
+
+    inline void clear(){
+      memset(_words.get(), 0, size_bytes());
+    }
+
+    inline bool allocated() const{
+      return _num_lines != 0;
+    }
+
+    inline uint64_t size_bytes() const{
+      return _num_lines * _words_per_line * sizeof(uint64_t);
+    }
+
+    // Line that hash maps to (fast range reduction of the upper 32 bits)
+    inline uint64_t* line(const uint64_t hash) const{
+      return _words.get() + ((hash >> 32) * _num_lines >> 32) * 
+        _words_per_line;
+    }
+
+    inline void prefetch(const uint64_t hash) const{
+      __builtin_prefetch(line(hash), 0, 3);
+    }
+
+    inline void insert(const uint64_t hash){
+      uint64_t* words = line(hash);
+      for(uint64_t i = 0; i < t_num_hash_fcns; i++){
+        const uint64_t probe = hash >> (9 * i);
+        words[probe & 7] |= 1ULL << ((probe >> 3) & 63);
+      }
+    }
+
+    inline bool contains(const uint64_t hash) const{
+      const uint64_t* words = line(hash);
+      bool present = true;
+      for(uint64_t i = 0; i < t_num_hash_fcns; i++){
+        const uint64_t probe = hash >> (9 * i);
+        present &= (words[probe & 7] >> ((probe >> 3) & 63)) & 1;
+      }
+      return present;
+    }
+  };
 }
 
 #endif
@@ -42,7 +42,14 @@ namespace CompressedCuckoo{
   // atom types
   const bool g_cache_aligned_allocate = true;
   const size_t g_cache_line_size_bytes = 64;  // Change this as necessary
-  const uint64_t stash_prefix_tag_len = 4;
+  const size_t g_huge_page_size_bytes = 2 * 1024 * 1024; // x86-64's 2 MiB pages
+  // Used if the L2's size can't be detected at run time
+  const size_t g_default_l2_cache_size_bytes = 1024 * 1024;
+  // Used if the L3's size can't be detected at run time
+  const size_t g_default_l3_cache_size_bytes = 8 * 1024 * 1024;
+  // The overflow stash keeps a bitmap of which bucket-id prefixes of this 
+  // many bits it has entries for, so up to 2^16 bits (8 KiB) per filter
+  const uint64_t stash_prefix_tag_len = 16;
   
   // Allows for up to 255 items per block
   const uint8_t max_fullness_counter_width = 8;
@@ -51,8 +58,34 @@ namespace CompressedCuckoo{
   enum struct AlternateBucketSelectionMethodEnum{
     TABLE_BASED_OFFSET,
     FUNCTION_BASED_OFFSET,
-    FAN_ET_AL_PARTIAL_KEY // Only use this if you can guarantee the total buckets 
+    FAN_ET_AL_PARTIAL_KEY, // Only use this if you can guarantee the total buckets 
                           // in the filter is a power of two
+    HUGE_PAGE_LOCAL_OFFSET // Like FUNCTION_BASED_OFFSET, but the offset wraps 
+                           // within the block's g_huge_page_size_bytes region
+  };
+
+  // Which kernel the batched lookups (likely_contains_many and friends) use.
+  // ADAPTIVE picks one per call based on the number of keys, the size of the 
+  // filter relative to the L2 cache, and how saturated the OTA is.
+  // The others force that kernel.  See select_lookup_kernel.
+  enum struct LookupKernelEnum{
+    ADAPTIVE,
+    ITEM_AT_A_TIME, // likely_contains on each key
+    BATCHED_OTA_GATED, // Prefetch primaries, then the secondaries that the 
+                       // OTA says might hold the key
+    BATCHED_PREFETCH_BOTH // Prefetch both candidate blocks of every key
+  };
+
+  // How the block storage is backed.  With 4 KiB pages, almost every random 
+  // lookup into a filter that is much bigger than the TLB's reach also misses
+  // the TLB.  Huge pages extend the reach by 512x (2 MiB) or 262144x (1 GiB).
+  enum struct StoragePolicyEnum{
+    DEFAULT_PAGES, // aligned_alloc to a cache line
+    TRANSPARENT_HUGE_PAGES, // 2 MiB aligned plus madvise(MADV_HUGEPAGE)
+    HUGETLB_2MB, // mmap with MAP_HUGETLB.  Needs pages reserved in 
+                 // /proc/sys/vm/nr_hugepages, otherwise it falls back to 
+                 // TRANSPARENT_HUGE_PAGES.
+    HUGETLB_1GB  // Same as above but with 1 GiB pages
   };
 
   enum struct InsertionMethodEnum{
@@ -62,6 +95,8 @@ namespace CompressedCuckoo{
     HYBRID_PIECEWISE, // Starts off as first-fit and then transitions to two choice
                   // once you hit a certain load factor 
     FIRST_FIT_OPT, // Transitions between two implementations of first-fit
+    ADAPTIVE // Picks FIRST_FIT, FIRST_FIT_OPT's second stage, or TWO_CHOICE 
+             // for each batch from the filter's load factor
   };
  
   enum struct CounterReadMethodEnum{
@@ -86,7 +121,10 @@ namespace CompressedCuckoo{
   enum struct FingerprintComparisonMethodEnum{
     VARIABLE_COUNT,
     FIXED_COUNT_AGGRESSIVE,
-    SEMI_FIXED
+    SEMI_FIXED,
+    SIMD_MASK // Compares the whole bucket at once with AVX2/AVX-512.  Only for 
+              // 8- and 16-bit fingerprints that are aligned within 512-bit 
+              // blocks.  Falls back to VARIABLE_COUNT otherwise.
   };
 
   enum struct ReductionMethodEnum{
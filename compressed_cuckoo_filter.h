@@ -44,10 +44,16 @@ How To Cite:
 #include <cstdlib>
 #include <cstring>
 
-#include <type_traits> // For std::conditional
+#include <type_traits> // For std::conditional and std::is_same
 #include <set>
 #include <unordered_set>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <limits>
 #include <algorithm>
+#include <numeric> // For std::partial_sum
+#include <sys/mman.h> // For mmap and madvise
 
 #include "fixed_point.h"
 #include "block.h"
@@ -56,6 +62,9 @@ How To Cite:
 #include "vector_types.h"
 #include "compressed_cuckoo_config.h"
 #include "bf.h"
+#include "simd_util.h"
+#include "batch_output.h"
+#include "key_column.h"
 
 #ifndef INLINE
 #define INLINE __attribute__((always_inline)) inline
@@ -63,6 +72,13 @@ How To Cite:
 
 #define UNROLL __attribute__((optimize("unroll-loops")))
 
+// For code that runs rarely (the stash, the cuckoo path search, bulk 
+// loading) or once per batch API call.  Inlining it buys nothing, and it 
+// used up GCC's inlining budget for the translation unit, which the kernels 
+// that run once per item need.  I don't also mark it cold since GCC then 
+// won't inline the shared helpers into it.
+#define NOINLINE __attribute__((noinline))
+
 struct Tester; // Forward declaration
 std::ostream& operator<<(std::ostream& os, __uint128_t integer);
 
@@ -74,6 +90,19 @@ namespace CompressedCuckoo{
       uint8_t block_and_bucket_overflow_count = 0;
   };
 
+  // One node of the breadth-first cuckoo path search (see find_cuckoo_path).
+  // Getting to it moves fingerprint out of bucket lbi, slot slot of the 
+  // parent node's block and into bucket_id.  The roots are the two candidate
+  // buckets of the item that's being inserted and have no parent (-1).
+  struct CuckooPathNode{
+    hash_t bucket_id;
+    atom_t fingerprint;
+    int32_t parent;
+    uint16_t lbi;
+    uint16_t slot;
+    uint16_t depth;
+  };
+
   // **** Morton filter ****
   // t_ota_len_bits is the length of the overflow tracking array in bits.
   // If the value is 0, then the functionality should default to a compressed 
@@ -84,6 +113,11 @@ namespace CompressedCuckoo{
   // good old templates.  If you think there's a better solution, let me know.
   // There are some examples of how to instantiate these template parameters in 
   // morton_sample_configs.h.
+  // t_batch_size is how many keys the *_many methods process at a time.  It 
+  // defaults to batch_size in vector_types.h.  t_hot_key_cache_entries is 
+  // the size of the optional hot-key result cache (see 
+  // hot_key_cache_index).  It's 0 (no cache) by default and otherwise 
+  // a power of 2 of at least 2.
   template<
     uint16_t t_slots_per_bucket, 
     uint16_t t_fingerprint_len_bits,
@@ -101,9 +135,30 @@ namespace CompressedCuckoo{
     bool t_morton_filter_functionality_enabled, 
     bool t_block_fullness_array_enabled,
     bool t_handle_conflicts,
-    FingerprintComparisonMethodEnum t_fingerprint_comparison_method
+    FingerprintComparisonMethodEnum t_fingerprint_comparison_method,
+    uint64_t t_batch_size = batch_size,
+    uint64_t t_hot_key_cache_entries = 0
   >
   struct CompressedCuckooFilter{
+    // The batch size and the per-batch scratch arrays.  Small, cache-resident
+    // filters get lower latency out of small batches, whereas big filters in 
+    // DRAM hide more of their misses with big ones.  These shadow the 
+    // defaults in vector_types.h, so they have to come before any other 
+    // member that uses them.
+    constexpr static uint_fast64_t batch_size = t_batch_size;
+    static_assert(batch_size % _HASH_N == 0, "The batch size must be a "
+      "multiple of _HASH_N (see hash_many)");
+    static_assert(batch_size < (1 << 16), "Indexes within a batch are stored "
+      "in 16 bits");
+    typedef std::array<atom_t, batch_size> ar_atom;
+    typedef std::array<uint16_t, batch_size> ar_u16;
+    typedef std::array<counter_t, batch_size> ar_counter;
+    typedef std::array<hash_t, batch_size> ar_hash;
+    typedef std::array<keys_t, batch_size> ar_key;
+    typedef std::array<StoreParams, batch_size> ar_store_params;
+    constexpr static uint_fast64_t batch_bitmap_words = (batch_size + 63) / 64;
+    typedef std::array<uint64_t, batch_bitmap_words> ar_bitmap;
+
     //FIXME: Recomment back in later private: // Default but explicitly state
     using block_t =  Morton::Block<t_block_size_bits, t_fingerprint_len_bits, 
       atom_t>;
@@ -143,10 +198,23 @@ namespace CompressedCuckoo{
     // block decreases as the LF increases, enough so to eventually warrant just 
     // grabbing both and calling it a day.  HYBRID_SIMPLE inserts using 
     // first fit for k-1 batches and then switches to two-choice for one batch, 
-    // and repeats.  The parameter k is tunable. You probably don't want to 
-    // touch this.
-    constexpr static InsertionMethodEnum _insertion_method = 
-      InsertionMethodEnum::FIRST_FIT;//HYBRID_SIMPLE;//FIRST_FIT;FIRST_FIT_OPT;//TWO_CHOICE;//HYBRID_PIECEWISE;
+    // and repeats.  The parameter k is tunable.  ADAPTIVE goes from first-fit
+    // to FIRST_FIT_OPT's second stage to two-choice as the filter fills up.
+    // The thresholds are load factors (see load_factor) of the whole filter, 
+    // not positions within an insert_many call, so incremental callers get 
+    // the same policy as bulk ones.  This is only the default.  Use 
+    // set_insertion_method and set_insertion_load_thresholds to change them 
+    // at run time.  On Morton3_8, with the cuckoo path search, first-fit 
+    // was as fast as the others at every load I tried up to 95% and set the 
+    // fewest OTA bits, so it stays the default.
+    constexpr static InsertionMethodEnum _default_insertion_method = 
+      InsertionMethodEnum::FIRST_FIT;//ADAPTIVE;//HYBRID_SIMPLE;//FIRST_FIT;FIRST_FIT_OPT;//TWO_CHOICE;//HYBRID_PIECEWISE;
+    // Below this load factor, ADAPTIVE uses first-fit.  HYBRID_PIECEWISE and 
+    // FIRST_FIT_OPT switch over here too.
+    constexpr static double _default_first_fit_max_load = 0.7;
+    // Below this one (and above the last), ADAPTIVE uses FIRST_FIT_OPT's 
+    // second stage.  Above it, it uses two-choice.
+    constexpr static double _default_first_fit_opt_max_load = 0.9;
 
     // How fullness counters are read (w/ or w/o supporting reading counters 
     // that cross atoms (machine words) in the 
@@ -218,6 +286,71 @@ namespace CompressedCuckoo{
     // doesn't require extra memory.
     constexpr static FingerprintComparisonMethodEnum 
       _fingerprint_comparison_method = t_fingerprint_comparison_method;
+
+    // How many batches ahead of the batch that is currently being compared 
+    // likely_contains_many hashes keys and prefetches their primary blocks.
+    // With a distance of 1, the primary blocks of batch N+1 are in flight 
+    // while batch N's fingerprints are compared, so the DRAM latency of the 
+    // next batch overlaps with the compute of the current one.  Set to 0 to 
+    // disable software prefetching.  Larger values help when the filter is 
+    // much bigger than the LLC and the batch compare is short, but too large 
+    // a distance evicts prefetched blocks before they are used.
+    constexpr static uint_fast16_t _lookup_prefetch_distance = 1;
+
+    // likely_contains_many_partitioned radix partitions the keys by the high 
+    // bits of their primary block ids so that each partition only touches a 
+    // contiguous region of _storage of about _partitioned_lookup_region_bytes.
+    // The fanout is capped at 2^_partitioned_lookup_max_radix_bits partitions
+    // so that the scatter itself stays cache and TLB friendly, and 
+    // partitioning is skipped unless there are at least 
+    // _partitioned_lookup_min_keys_per_partition keys per partition and at 
+    // least one key per block on average.  Partitioning costs about three 
+    // extra passes over 12 bytes per key, which only pays off if blocks are 
+    // probed more than once while their region is cached.
+    constexpr static uint64_t _partitioned_lookup_region_bytes = 1024 * 1024;
+    constexpr static uint_fast16_t _partitioned_lookup_max_radix_bits = 8;
+
+    // bulk_load sorts keys into partitions of this many blocks.  With 3_8 
+    // blocks at 95% load, a partition's keys take about 700 KB, so sorting 
+    // one by block stays in the L2.
+    constexpr static uint64_t _bulk_load_partition_blocks = 2048;
+    constexpr static uint64_t _partitioned_lookup_min_keys_per_partition = 
+      4 * batch_size;
+
+    // Thresholds for LookupKernelEnum::ADAPTIVE (see select_lookup_kernel).
+    // Calls with fewer than _adaptive_item_at_a_time_max_keys keys are done 
+    // one key at a time since hashing and probing a padded batch costs more
+    // than a few scalar lookups.  With 128-key batches, 32 keys were faster 
+    // one at a time and 64 were faster batched.  Filters bigger than the L2 
+    // whose OTAs have at least _adaptive_prefetch_both_min_ota_percent 
+    // percent of their bits set prefetch both candidate blocks up front since
+    // most negative lookups will need the secondary block anyway.  Morton3_8
+    // at 97% load (14% of the OTA bits set) was still about 1.5x faster with 
+    // OTA gating at 2^28 slots, so the threshold is conservative.
+    constexpr static uint64_t _adaptive_item_at_a_time_max_keys = 
+      (3 * batch_size) / 8;
+    constexpr static uint64_t _adaptive_prefetch_both_min_ota_percent = 75;
+
+    // With the prefilter or the hot-key cache, batched lookups go through 
+    // likely_contains_many_compacted, which works on windows of about 2K 
+    // keys so that the keys that still need the table can be compacted into
+    // full batches without the staging area spilling out of the L1.
+    constexpr static uint64_t _compacted_window_batches = 
+      batch_size >= 2048 ? 1 : 2048 / batch_size;
+
+    // The columnar batch APIs gather keys that aren't already dense keys_t 
+    // into a buffer of this many keys at a time (16 KB with 64-bit keys), 
+    // which stays in the L1 between the gather and the lookups or inserts.
+    constexpr static uint64_t _column_chunk_keys = 
+      _compacted_window_batches * batch_size;
+
+    // Entries in the hot-key result cache.  With 0, the cache is compiled 
+    // out and lookups, insertions, and deletions don't touch it.
+    constexpr static uint64_t _hot_key_cache_entries = t_hot_key_cache_entries;
+    constexpr static bool _hot_key_cache_enabled = _hot_key_cache_entries > 0;
+    static_assert(!_hot_key_cache_enabled || (_hot_key_cache_entries >= 2 && 
+      __builtin_popcountll(_hot_key_cache_entries) == 1), "The hot-key cache"
+      " must be a power of 2 of at least 2 entries");
     
     constexpr static uint_fast8_t _max_pop_count_width_in_bits = 128;
  
@@ -257,6 +390,18 @@ namespace CompressedCuckoo{
     constexpr static uint_fast64_t _fingerprint_offset = _fullness_counters_offset + _buckets_per_block * _fullness_counter_width + _ota_len_bits;
 
     atom_t _popcount_masks[max_fullness_counter_width] = {};
+
+    // Default bounds on the breadth-first cuckoo path search that places 
+    // items whose candidate blocks are full (see find_cuckoo_path).  Paths 
+    // are at most _default_cuckoo_path_max_depth moves long and each level 
+    // of the search has at most _default_cuckoo_path_max_breadth blocks.
+    constexpr static uint_fast16_t _default_cuckoo_path_max_depth = 100;
+    constexpr static uint_fast16_t _default_cuckoo_path_max_breadth = 4;
+    // Most items that the overflow stash holds (see stash_insert).  With 
+    // remapping, each one takes two 16-byte entries, so a full stash is 
+    // 16 KiB, which stays in the L1 or L2 while it's being used.
+    constexpr static uint64_t _stash_capacity = 512;
+    constexpr static uint64_t _stash_entries_per_item = _remap_enabled ? 2 : 1;
     __uint128_t _popcount_masks128[max_fullness_counter_width] = {}; 
     
     using fca_t = typename std::conditional<(_fullness_counter_width * _buckets_per_block <= 64), uint64_t, __uint128_t>::type;
@@ -268,12 +413,75 @@ namespace CompressedCuckoo{
     BitMixMurmur _hasher; // Yields more consistent performance
     // The number of times that we've doubled the filter's capacity
     uint_fast16_t _resize_count;   
+    // See StoragePolicyEnum in compressed_cuckoo_config.h.  
+    // _storage_mapped_bytes is the length of _storage's mapping if it came 
+    // from mmap and 0 otherwise.
+    const StoragePolicyEnum _storage_policy;
+    size_t _storage_mapped_bytes;
+    // The batched lookup kernel to use (see LookupKernelEnum), the size of 
+    // the L2 in bytes, and a running count of the OTA bits that are set (they 
+    // are never cleared), which lets the adaptive lookups track how 
+    // saturated the OTAs are without scanning the table.
+    LookupKernelEnum _lookup_kernel;
+    uint64_t _l2_cache_size_bytes;
+    uint64_t _ota_bits_set;
+    // The insertion method and its thresholds (see 
+    // _default_insertion_method) and the number of items in the filter, 
+    // stash included, which the inserts and deletes keep up to date so that
+    // the load factor doesn't need a scan of the table.
+    InsertionMethodEnum _insertion_method;
+    double _first_fit_max_load;
+    double _first_fit_opt_max_load;
+    uint64_t _item_count;
+    // Optional dense copy of each block's OTA (see enable_ota_summary).  It's
+    // empty when disabled.
+    using ota_summary_t = typename std::conditional<(_ota_len_bits <= 8), 
+      uint8_t, typename std::conditional<(_ota_len_bits <= 16), uint16_t, 
+      typename std::conditional<(_ota_len_bits <= 32), uint32_t, 
+      uint64_t>::type>::type>::type;
+    std::vector<ota_summary_t> _ota_summary;
+    // Optional cache-resident Bloom filter in front of the table (see 
+    // enable_prefilter), the number of lookups that consulted it and that it
+    // rejected, and the number of deletions since it was last rebuilt.  The 
+    // counters are mutable because lookups are const, and they're relaxed 
+    // atomics so that concurrent lookups aren't a data race (see 
+    // count_prefilter_lookups).
+    BlockedBF::CacheLineBloomFilter<> _prefilter;
+    mutable std::atomic<uint64_t> _prefilter_lookups;
+    mutable std::atomic<uint64_t> _prefilter_rejections;
+    uint64_t _prefilter_stale_deletions;
+    // Hot-key result cache (see hot_key_cache_index) and its lookup and
+    // hit counts.  Lookups are const but fill the cache, hence mutable.
+    mutable std::vector<uint64_t> _hot_key_cache;
+    mutable uint64_t _hot_key_cache_lookups;
+    mutable uint64_t _hot_key_cache_hits;
+    // Bounds on the cuckoo path search (see set_cuckoo_path_search_bounds), 
+    // its queue and open-addressed set of visited blocks (block id + 1, so 
+    // that 0 is empty), and the xorshift64* state that it and 
+    // random_kickout_cuckoo draw random numbers from.
+    uint_fast16_t _cuckoo_path_max_depth;
+    uint_fast16_t _cuckoo_path_max_breadth;
+    std::vector<CuckooPathNode> _cuckoo_path_nodes;
+    std::vector<hash_t> _cuckoo_path_visited_blocks;
+    uint64_t _rng_state;
+    // Overflow stash (see stash_insert).  It's the sorted (bucket, 
+    // fingerprint) entries of the items that didn't fit, a bitmap of the 
+    // bucket-prefix tags (bucket id >> _stash_tag_shift) that have entries, 
+    // the shift that makes the tags stash_prefix_tag_len bits long, and a 
+    // flag that's set iff the stash has anything in it.
+    using stash_entry_t = std::pair<hash_t, atom_t>;
+    std::vector<stash_entry_t> _stash;
+    std::vector<uint64_t> _stash_tags;
+    uint_fast8_t _stash_tag_shift;
+    bool _stash_nonempty;
 
     friend Tester; // Class with a bunch of test functions in test.cc
 
   public:
   // Constructor
-  explicit CompressedCuckooFilter(uint64_t total_slots) :
+  // storage_policy only applies when g_cache_aligned_allocate is set.
+  explicit CompressedCuckooFilter(uint64_t total_slots, 
+    StoragePolicyEnum storage_policy = StoragePolicyEnum::DEFAULT_PAGES) :
     // Hashing mechanism requires even number of total buckets
     // We round up to a number of buckets that's even but also for which 
     // _total_buckets % _buckets_per_block is 0. So in the worst case, 
@@ -283,7 +491,28 @@ namespace CompressedCuckoo{
     _total_slots(_total_buckets * _slots_per_bucket), // Logical slots not physical
     _total_blocks(_total_buckets / _buckets_per_block),
     _block_fullness_array(_block_fullness_array_enabled ? _total_blocks : 0, 0),
-    _resize_count(0)
+    _resize_count(0),
+    _storage_policy(storage_policy),
+    _storage_mapped_bytes(0),
+    _lookup_kernel(LookupKernelEnum::ADAPTIVE),
+    _l2_cache_size_bytes(util::detect_cache_size_bytes(2, 
+      g_default_l2_cache_size_bytes)),
+    _ota_bits_set(0),
+    _insertion_method(_default_insertion_method),
+    _first_fit_max_load(_default_first_fit_max_load),
+    _first_fit_opt_max_load(_default_first_fit_opt_max_load),
+    _item_count(0),
+    _prefilter_lookups(0),
+    _prefilter_rejections(0),
+    _prefilter_stale_deletions(0),
+    _hot_key_cache(_hot_key_cache_entries),
+    _hot_key_cache_lookups(0),
+    _hot_key_cache_hits(0),
+    _cuckoo_path_max_depth(_default_cuckoo_path_max_depth),
+    _cuckoo_path_max_breadth(_default_cuckoo_path_max_breadth),
+    _rng_state(0x9e3779b97f4a7c15ULL),
+    _stash_tag_shift(0),
+    _stash_nonempty(false)
   {
 
     // Supporting dual use as a compressed cuckoo filter and Morton filter
@@ -333,12 +562,35 @@ namespace CompressedCuckoo{
  
     // Allocate heap memory so that it's cache aligned.
     heap_allocate_table_and_summed_counters_buffer();
+    clear_hot_key_cache();
+    set_cuckoo_path_search_bounds(_cuckoo_path_max_depth, 
+      _cuckoo_path_max_breadth);
+    update_stash_tag_shift();
+  }
+
+  // Builds a filter of total_slots slots that holds keys with bulk_load.  
+  // Keys that don't fit are reported on std::cerr like with insert, and 
+  // size() comes up short of num_keys.  The second version also fills in 
+  // status like bulk_load does, which says which keys those were.
+  CompressedCuckooFilter(uint64_t total_slots, const keys_t* keys, 
+    uint64_t num_keys, uint32_t num_threads = 0, 
+    StoragePolicyEnum storage_policy = StoragePolicyEnum::DEFAULT_PAGES) :
+    CompressedCuckooFilter(total_slots, storage_policy){
+    std::vector<bool> status(num_keys);
+    bulk_load(keys, num_keys, status, num_threads);
+  }
+
+  CompressedCuckooFilter(uint64_t total_slots, const keys_t* keys, 
+    uint64_t num_keys, std::vector<bool>& status, uint32_t num_threads = 0, 
+    StoragePolicyEnum storage_policy = StoragePolicyEnum::DEFAULT_PAGES) :
+    CompressedCuckooFilter(total_slots, storage_policy){
+    bulk_load(keys, num_keys, status, num_threads);
   }
 
   ~CompressedCuckooFilter(){
     if(g_cache_aligned_allocate){
       free(_summed_counters);
-      free(_storage);
+      free_block_storage(_storage, _storage_mapped_bytes);
     }
     else{
       delete[] _summed_counters;
@@ -377,12 +629,88 @@ namespace CompressedCuckoo{
     return util::fast_mod_alternative<hash_t>(raw_hash & mask, modulus, shift);
   }
 
+  // Vector versions of fingerprint_function and map_to_bucket.  They must 
+  // produce exactly what the scalar versions do.
+  INLINE vH_hash fingerprint_functionN(const vH_hash raw_hashes) const{
+    constexpr hash_t shift = 8 * sizeof(hash_t) - _fingerprint_len_bits;
+    vH_hash fingerprints = raw_hashes >> shift;
+    if(_special_null_fingerprint){
+      fingerprints |= reinterpret_cast<vH_hash>(fingerprints == 0) & 1;
+    }
+    return fingerprints;
+  }
+
+  INLINE vH_hash map_to_bucketN(const vH_hash raw_hashes, 
+    const vH_hash fingerprints, const hash_t modulus) const{
+    constexpr hash_t one = 1;
+    constexpr hash_t shift = 8 * sizeof(hash_t) - _fingerprint_len_bits;
+    constexpr hash_t mask = (one << shift) - one;
+    if (_resizing_enabled){
+      const hash_t original_modulus = modulus >> _resize_count;
+      const vH_hash original_bucket_ids = util::fast_mod_alternativeN<vH_hash, 
+        hash_t>(raw_hashes & mask, original_modulus, shift);
+      const vH_hash original_block_ids = original_bucket_ids / 
+        static_cast<hash_t>(_buckets_per_block);
+      const vH_hash lbis = original_bucket_ids - original_block_ids * 
+        static_cast<hash_t>(_buckets_per_block);
+      const vH_hash new_block_ids = (original_block_ids << _resize_count) | 
+        ((fingerprints >> (_fingerprint_len_bits - _resize_count)) & 
+        ((one << _resize_count) - one));
+      return new_block_ids * static_cast<hash_t>(_buckets_per_block) + lbis;
+    }
+    return util::fast_mod_alternativeN<vH_hash, hash_t>(raw_hashes & mask, 
+      modulus, shift);
+  }
+
   // The number of buckets in the table must be a power of 2 to use this.
   INLINE hash_t fan_et_al_partial_key_cuckoo_hash_alternate_bucket(hash_t 
     bucket_id, const atom_t fingerprint) const{
     return (bucket_id ^ raw_primary_hash(fingerprint)) & (_total_buckets - 1);
   }
 
+  // The number of blocks in a g_huge_page_size_bytes region of the block store
+  constexpr static uint64_t _huge_page_region_blocks = 
+    g_huge_page_size_bytes / sizeof(block_t);
+
+  // Applies the signed offset to bucket_id but wraps within the huge page 
+  // region that holds bucket_id's block rather than within the whole table, 
+  // so both of a key's blocks are in the same region.  With the huge page 
+  // storage policies, the regions line up with the pages, so a lookup needs 
+  // at most one TLB translation.  The final region may be shorter if the 
+  // table isn't a multiple of the region size.  Regions and the table are an 
+  // even number of buckets in length and the offset is odd, so the mapping 
+  // flips the parity of the bucket and thus its own inverse like the 
+  // table-wide wrap is.  bucket_id must be from before any resizing.  Each 
+  // resize spreads a region's blocks over twice as many blocks, so after 
+  // resize<k>() a key's two blocks are within the same 2^k regions instead.
+  INLINE hash_t huge_page_local_alternate_bucket(hash_t bucket_id, 
+    int64_t offset) const{
+    constexpr hash_t region_buckets = _huge_page_region_blocks * 
+      _buckets_per_block;
+    const hash_t table_buckets = _resizing_enabled ? 
+      _total_buckets >> _resize_count : _total_buckets;
+    const hash_t region_start = bucket_id - bucket_id % region_buckets;
+    const hash_t region_len = std::min<hash_t>(region_buckets, 
+      table_buckets - region_start);
+    // Offsets are much shorter than a full region, so only a short final 
+    // region needs the division
+    int64_t local_offset = offset;
+    if(static_cast<hash_t>(offset < 0 ? -offset : offset) >= region_len){
+      local_offset = offset < 0 ? 
+        -static_cast<int64_t>(static_cast<hash_t>(-offset) % region_len) : 
+        static_cast<int64_t>(static_cast<hash_t>(offset) % region_len);
+    }
+    int64_t local_id = static_cast<int64_t>(bucket_id - region_start) + 
+      local_offset;
+    if(local_id < 0){
+      local_id += region_len;
+    }
+    if(static_cast<uint64_t>(local_id) >= region_len){
+      local_id -= region_len;
+    }
+    return region_start + local_id;
+  }
+
   // See comment above
   INLINE hash_t determine_alternate_bucket(hash_t bucket_id,
     const atom_t fingerprint) const{
@@ -409,6 +737,12 @@ namespace CompressedCuckoo{
         return fan_et_al_partial_key_cuckoo_hash_alternate_bucket(bucket_id, 
           fingerprint);
         break;
+
+      case AlternateBucketSelectionMethodEnum::HUGE_PAGE_LOCAL_OFFSET:{
+        offset = ((raw_primary_hash(fingerprint) & 0x1fff) + 
+          (_buckets_per_block)) | one;
+        break;
+      }
     }
     
     if(_resizing_enabled){
@@ -424,6 +758,11 @@ namespace CompressedCuckoo{
     
     /* An alternate implementation that works on big tables */
     int64_t output = static_cast<int64_t>(bucket_id) + offset;
+    // Already in range, so the wrapping below doesn't change it
+    if(_alternate_bucket_selection_method == 
+      AlternateBucketSelectionMethodEnum::HUGE_PAGE_LOCAL_OFFSET){
+      output = huge_page_local_alternate_bucket(bucket_id, offset);
+    }
     if(_resizing_enabled){
       if(output < 0){
         output += _total_buckets >> _resize_count;
@@ -450,10 +789,72 @@ namespace CompressedCuckoo{
     
   }
 
-  inline block_t* allocate_cache_aligned_storage(uint64_t total_blocks){
-    size_t allocation_size = sizeof(block_t) * total_blocks;
-    block_t* storage = static_cast<block_t*>(aligned_alloc(
-      g_cache_line_size_bytes, allocation_size));
+  // Allocates the memory for total_blocks blocks following _storage_policy.
+  // mapped_bytes is set to the length of the mapping if the memory came from 
+  // mmap and to 0 if it came from aligned_alloc.  Pass it back to 
+  // free_block_storage.
+  inline block_t* allocate_block_storage(uint64_t total_blocks, 
+    size_t& mapped_bytes) const{
+    const size_t allocation_size = sizeof(block_t) * total_blocks;
+    mapped_bytes = 0;
+    switch(_storage_policy){
+      case StoragePolicyEnum::DEFAULT_PAGES:{
+        return static_cast<block_t*>(aligned_alloc(g_cache_line_size_bytes, 
+          (allocation_size + g_cache_line_size_bytes - 1) & 
+          ~(g_cache_line_size_bytes - 1)));
+      }
+      case StoragePolicyEnum::HUGETLB_2MB:
+      case StoragePolicyEnum::HUGETLB_1GB:{
+        const uint_fast16_t log2_page_size = 
+          _storage_policy == StoragePolicyEnum::HUGETLB_1GB ? 30 : 21;
+        const size_t page_size = static_cast<size_t>(1) << log2_page_size;
+        const size_t length = (allocation_size + page_size - 1) & 
+          ~(page_size - 1);
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#ifdef MAP_HUGE_SHIFT
+        flags |= log2_page_size << MAP_HUGE_SHIFT;
+#endif
+        void* storage = mmap(nullptr, length, PROT_READ | PROT_WRITE, flags, 
+          -1, 0);
+        if(storage != MAP_FAILED){
+          mapped_bytes = length;
+          return static_cast<block_t*>(storage);
+        }
+        // No huge pages of that size are reserved, so settle for transparent
+        // huge pages.
+      }
+      // Falls through
+      case StoragePolicyEnum::TRANSPARENT_HUGE_PAGES:{
+        const size_t length = (allocation_size + g_huge_page_size_bytes - 1) & 
+          ~(g_huge_page_size_bytes - 1);
+        void* storage = aligned_alloc(g_huge_page_size_bytes, length);
+#ifdef MADV_HUGEPAGE
+        if(storage != NULL){
+          // Only a hint.  It's a no-op if THP is disabled system wide.
+          madvise(storage, length, MADV_HUGEPAGE);
+        }
+#endif
+        return static_cast<block_t*>(storage);
+      }
+    }
+    return NULL; // Put here to make the compiler happy
+  }
+
+  inline void free_block_storage(block_t* storage, size_t mapped_bytes){
+    if(mapped_bytes){
+      munmap(storage, mapped_bytes);
+    }
+    else{
+      free(storage);
+    }
+  }
+
+  inline block_t* allocate_cache_aligned_storage(uint64_t total_blocks, 
+    size_t& mapped_bytes){
+    block_t* storage = allocate_block_storage(total_blocks, mapped_bytes);
+    if(storage == NULL){
+      return storage;
+    }
     // Currently set to false because clear_swath hasn't been rigorously tested
     constexpr bool _only_clear_ota_and_fca = false;
     if(!_only_clear_ota_and_fca){ // Competitive with the code in the loop below
@@ -494,7 +895,8 @@ namespace CompressedCuckoo{
     if(g_cache_aligned_allocate){ // Allocate heap memory so that it's cache 
                                 // aligned
       // Allocate memory for the block store
-      _storage = allocate_cache_aligned_storage(_total_blocks);
+      _storage = allocate_cache_aligned_storage(_total_blocks, 
+        _storage_mapped_bytes);
 
       size_t allocation_size = sizeof(*_summed_counters) * 
         (_buckets_per_block + 1);
@@ -615,18 +1017,9 @@ namespace CompressedCuckoo{
         }
         break;
       case ReductionMethodEnum::POP_CNT:{ 
-        // FIXME: Should ideally check whether the start and end are in the 
-        // same 64-bit word not the 0th 64-bit word of the block
-        constexpr bool use_popcnt64 = (_fullness_counters_offset + 
-          _fullness_counter_width * _buckets_per_block) <= 64;
-        if(use_popcnt64){
-          return exclusive_reduce_with_popcount64<batch_size>(block_ids, 
-            counter_indexes);
-        }
-        else{
-          return exclusive_reduce_with_popcount128<batch_size>(block_ids,
-            counter_indexes);
-        }
+        std::array<counter_t, SIZE> unused_loads;
+        exclusive_reduce_with_popcount_simd<SIZE, false>(block_ids, 
+          counter_indexes, sums, unused_loads);
         break;
       }
       case ReductionMethodEnum::PARALLEL_REDUCE:
@@ -681,55 +1074,99 @@ namespace CompressedCuckoo{
     return sum & ((one << (_fullness_counter_width * (masked_count + one))) - one);
   }
  
-  template<uint64_t SIZE>
-  INLINE std::array<counter_t, SIZE> exclusive_reduce_with_popcount64(
+  // Computes the exclusive reductions of exclusive_reduce_many and, if 
+  // t_compute_loads, the number of fingerprints in each block (i.e., the full 
+  // reduction) for v8_lanes keys at a time.  The FCA words of the blocks are 
+  // loaded into the lanes of a vector, the counters at or past each key's 
+  // counter index are masked off, and then the counters are summed one bit 
+  // position at a time with per-lane popcounts, which is the same algorithm 
+  // as exclusive_reduce_with_popcount64/128.  Handles FCAs of up to 128 bits.
+  template<uint64_t SIZE, bool t_compute_loads>
+  INLINE void exclusive_reduce_with_popcount_simd(
     const std::array<hash_t, SIZE>& block_ids, 
-    const std::array<counter_t, SIZE>& counter_indexes) const{
-    constexpr uint64_t one = 1;
-    uint64_t counters;
-    std::array<counter_t, SIZE> sums;
+    const std::array<counter_t, SIZE>& counter_indexes, 
+    std::array<counter_t, SIZE>& sums, 
+    std::array<counter_t, SIZE>& loads) const{
+    constexpr uint64_t fca_bits = _fullness_counter_width * _buckets_per_block;
+    constexpr bool two_words = fca_bits > 64;
+    static_assert(fca_bits <= 128, "POP_CNT reductions support FCAs of at "
+      "most 128 bits");
+    static_assert(SIZE % v8_lanes == 0, "Batch must be a multiple of 8 keys");
+    constexpr __uint128_t one = 1;
+    constexpr __uint128_t fca_mask = fca_bits == 128 ? ~static_cast<
+      __uint128_t>(0) : (one << fca_bits) - one;
+    constexpr uint64_t fca_mask_lo = static_cast<uint64_t>(fca_mask);
+    constexpr uint64_t fca_mask_hi = static_cast<uint64_t>(fca_mask >> 64);
+    const uint64_t width = _fullness_counter_width;
+
+    // The popcount masks shifted for each bit of a counter
+    uint64_t popcount_masks_lo[max_fullness_counter_width];
+    uint64_t popcount_masks_hi[max_fullness_counter_width];
+    for(uint64_t j = 0; j < width; j++){
+      const __uint128_t m = _popcount_masks128[0] << j;
+      popcount_masks_lo[j] = static_cast<uint64_t>(m);
+      popcount_masks_hi[j] = static_cast<uint64_t>(m >> 64);
+    }
 
-    uint64_t popcount_mask = _popcount_masks[0];
-    for(uint64_t i = 0; i < SIZE; i++){
-      memcpy(&counters, &_storage[block_ids[i]], sizeof(__uint64_t));
-      uint64_t mask = (one << (_fullness_counter_width * (counter_indexes[i])))
-        - one;
-      counters &= mask;
-      sums[i] = 0;
-      for(uint8_t j = 0; j < _fullness_counter_width; j++){
-        sums[i] += __builtin_popcountll(counters & (popcount_mask << j)) << j;
+    for(uint64_t i = 0; i < SIZE; i += v8_lanes){
+      v8_u64 lo, hi = {}, shifts;
+      for(uint64_t l = 0; l < v8_lanes; l++){
+        const atom_t* fca = reinterpret_cast<const atom_t*>(
+          &_storage[block_ids[i + l]]);
+        memcpy(&lo[l], fca, sizeof(uint64_t));
+        if(two_words){
+          memcpy(&hi[l], fca + 1, sizeof(uint64_t));
+        }
+        shifts[l] = width * counter_indexes[i + l];
+      }
+      lo &= fca_mask_lo;
+      hi &= fca_mask_hi;
+      const v8_u64 lo_shifts = shifts < 64 ? shifts : 64;
+      const v8_u64 hi_shifts = shifts < 64 ? 0 : shifts - 64;
+      const v8_u64 prefix_lo = lo & low_bits_mask8(lo_shifts);
+      const v8_u64 prefix_hi = hi & low_bits_mask8(hi_shifts);
+
+      v8_u64 sum = {};
+      v8_u64 load = {};
+      for(uint64_t j = 0; j < width; j++){
+        sum += popcount8(prefix_lo & popcount_masks_lo[j]) << j;
+        if(two_words){
+          sum += popcount8(prefix_hi & popcount_masks_hi[j]) << j;
+        }
+        if(t_compute_loads){
+          load += popcount8(lo & popcount_masks_lo[j]) << j;
+          if(two_words){
+            load += popcount8(hi & popcount_masks_hi[j]) << j;
+          }
+        }
+      }
+      for(uint64_t l = 0; l < v8_lanes; l++){
+        sums[i + l] = sum[l];
+        if(t_compute_loads){
+          loads[i + l] = load[l];
+        }
       }
     }
-    return sums;
   }
-   
-  template<uint64_t SIZE>
-  INLINE std::array<counter_t, SIZE> exclusive_reduce_with_popcount128(
-    const std::array<hash_t, SIZE>& block_ids, 
-    const std::array<counter_t, SIZE>& counter_indexes) const{
-    constexpr __uint128_t one = 1;
-    constexpr uint64_t uint64_max = ~(static_cast<uint64_t>(0)); 
-
-    std::array<__uint128_t, SIZE> counters;
-    std::array<counter_t, SIZE> sums;
 
-    for(uint64_t i = 0; i < SIZE; i++){
-      memcpy(&counters[i], &_storage[block_ids[i]], sizeof(__uint128_t));
-      __uint128_t mask = (one << (_fullness_counter_width * 
-        (counter_indexes[i]))) - one;
-      counters[i] &= mask;
-      sums[i] = 0;
-      __uint128_t popcount_mask128 = _popcount_masks128[0];
-      for(uint8_t j = 0; j < _fullness_counter_width; j++){
-        const uint64_t popcount_mask1 = popcount_mask128 & uint64_max;   
-        const uint64_t popcount_mask2 = popcount_mask128 >> 64;
-        sums[i] += __builtin_popcountll(counters[i] & popcount_mask1) << j;
-        sums[i] += __builtin_popcountll((counters[i] >> 64) & popcount_mask2) << j;
-        popcount_mask128 <<= 1;
-      } // This version that shifts the mask rather than precomputing it 
-        // at different offsets is a good deal faster.  Register pressure?
+  // Computes the start index of each bucket and the load of its block
+  template<uint64_t SIZE>
+  INLINE void exclusive_reduce_and_load_many(
+    const std::array<hash_t, SIZE>& block_ids,
+    const std::array<counter_t, SIZE>& counter_indexes,
+    std::array<counter_t, SIZE>& sums, 
+    std::array<counter_t, SIZE>& loads) const{
+    if(_reduction_method == ReductionMethodEnum::POP_CNT){
+      exclusive_reduce_with_popcount_simd<SIZE, true>(block_ids, 
+        counter_indexes, sums, loads);
+    }
+    else{
+      sums = exclusive_reduce_many<SIZE>(block_ids, counter_indexes);
+      for(uint64_t i = 0; i < SIZE; i++){
+        loads[i] = exclusive_reduce(_storage[block_ids[i]], 
+          _buckets_per_block);
+      }
     }
-    return sums;
   }
 
   INLINE uint16_t exclusive_reduce_with_popcount128(const block_t& b, 
@@ -856,127 +1293,1946 @@ namespace CompressedCuckoo{
     }
   }
 
-  inline hash_t raw_primary_hash(keys_t key) const{
-    return _hasher(key);
+  inline hash_t raw_primary_hash(keys_t key) const{
+    return _hasher(key);
+  }
+
+  // The batch APIs accept any number of keys.  Whole batches of batch_size 
+  // keys take the vectorized paths, and the remaining num_keys % batch_size 
+  // keys go through a partial batch whose unused lanes are masked off.  The 
+  // insertion and deletion kernels take the number of lanes in use, so a 
+  // partial batch never stores or deletes anything for the unused lanes, 
+  // and lookups ignore the unused lanes' results.  Besides the 
+  // std::vector overloads, each API has a template overload that takes a pair
+  // of pointers to keys_t or of std::vector<keys_t> iterators (std::array's 
+  // iterators are pointers with libstdc++ and libc++).  insert_many returns 
+  // whether every key was stored.
+  inline bool insert_many(const std::vector<keys_t>& keys, 
+    std::vector<bool>& status, const uint64_t num_keys){
+    return insert_many_impl(keys.data(), num_keys, status);
+  }
+
+  // The iterator overloads read the keys straight from &*first, so they only
+  // accept the iterators that are known to be contiguous.  C++11 has no way 
+  // to ask, and a std::deque iterator, say, would compile and read past the 
+  // end of its chunk.
+  template<class ContiguousIterator>
+  INLINE static const keys_t* contiguous_keys(ContiguousIterator first){
+    static_assert(std::is_same<ContiguousIterator, keys_t*>::value || 
+      std::is_same<ContiguousIterator, const keys_t*>::value || 
+      std::is_same<ContiguousIterator, 
+        std::vector<keys_t>::iterator>::value || 
+      std::is_same<ContiguousIterator, 
+        std::vector<keys_t>::const_iterator>::value, 
+      "The iterator overloads take pointers to keys_t or std::vector<keys_t> "
+      "iterators");
+    return &*first;
+  }
+
+  template<class ContiguousIterator>
+  inline bool insert_many(ContiguousIterator first, ContiguousIterator last, 
+    std::vector<bool>& status){
+    return first == last ? true : insert_many_impl(contiguous_keys(first), 
+      last - first, status);
+  }
+
+  // first_key_index is the index of keys[0] in the caller's whole input, 
+  // which the hybrid insertion methods use to pick a kernel for each batch.
+  NOINLINE bool insert_many_impl(const keys_t* keys, const uint64_t num_keys, 
+    std::vector<bool>& status, const uint64_t first_key_index = 0){
+    const uint64_t items_before = _item_count;
+    // The last batch may be a partial one.  Its lanes past the end repeat 
+    // the first key of the batch, and the kernels only store the first 
+    // count lanes.
+    for(hash_t i = 0; i < num_keys; i += batch_size){
+      const uint_fast32_t count = std::min<uint64_t>(batch_size, 
+        num_keys - i);
+      ar_hash bucket_hashes;
+      ar_atom fingerprints;
+      ar_hash raw_hashes;
+      hash_t* const raw_hashes_out = _hot_key_cache_enabled ? 
+        raw_hashes.data() : nullptr;
+      if(count == batch_size){
+        hash_many(&keys[i], bucket_hashes, fingerprints, raw_hashes_out);
+      }
+      else{
+        hash_many_partial(&keys[i], count, bucket_hashes, fingerprints, 
+          raw_hashes_out);
+      }
+      if(_hot_key_cache_enabled){
+        for(uint_fast32_t j = 0; j < count; j++){
+          hot_key_cache_invalidate(raw_hashes[j]);
+        }
+      }
+      switch(select_insertion_method(first_key_index + i)){
+        case InsertionMethodEnum::FIRST_FIT:
+          table_store_many(bucket_hashes, fingerprints, status, i, count);
+          break;
+        case InsertionMethodEnum::TWO_CHOICE:
+          table_store_many_two_choice(bucket_hashes, fingerprints, status, i,
+            false, count);
+          break;
+        case InsertionMethodEnum::FIRST_FIT_OPT:
+          table_store_many_two_choice(bucket_hashes, fingerprints, status, i,
+            true, count);
+          break;
+        default: // Put here to make the compiler happy
+          std::cerr << "SOMETHING IS WRONG IF YOU ARE HERE\n";
+          exit(1);
+          break;
+      }
+      for(uint_fast32_t j = 0; j < count; j++){
+        if(!status[i + j]){
+          status[i + j] = stash_insert(bucket_hashes[j], fingerprints[j]);
+        }
+        _item_count += status[i + j];
+      }
+      if(prefilter_enabled()){
+        for(uint_fast32_t j = 0; j < count; j++){
+          if(status[i + j]){
+            prefilter_insert(bucket_hashes[j], fingerprints[j]);
+          }
+        }
+      }
+    }
+    return _item_count - items_before == num_keys;
+  }
+
+  // Replaces the filter's contents with keys, building it a block at a time 
+  // instead of a key at a time.  Like insert_many, status[i] says whether 
+  // keys[i] was stored, and it returns whether all of them were.  The 
+  // blocks are split into partitions of _bulk_load_partition_blocks blocks,
+  // and it takes four passes:
+  //   1. Each thread hashes a range of the keys and counts how many land in 
+  //      each partition.
+  //   2. Each thread hashes its keys again and scatters them, packed as 
+  //      primary bucket and fingerprint, to their partitions.
+  //   3. Each thread takes a contiguous range of partitions.  For each one, 
+  //      it counting sorts the partition's keys by block, which stays in the 
+  //      L2, and then writes each block, FCA and FSA, in one sequential 
+  //      pass.  Buckets are filled in order, and the fingerprints that don't 
+  //      fit in their primary bucket or block are set aside.
+  //   4. The fingerprints that were set aside go through table_store one at 
+  //      a time on the calling thread, which puts them in their secondary 
+  //      buckets (kicking others out if it has to) and sets their OTA bits.
+  // Hashing twice is cheaper than writing the hashes out and reading them 
+  // back, and scattering to partitions first means that neither the scatter
+  // nor the sort has to write to more than a few thousand places at once.  
+  // Scratch space is about 8 bytes per key plus a partition's worth per 
+  // thread.  Since items placed in pass 3 can't fail, status only depends on 
+  // pass 4, and a failed fingerprint's status goes to one of the keys with 
+  // that bucket and fingerprint (they're indistinguishable to the filter).  
+  // The OTA summary, the prefilter, and the hot-key cache are rebuilt to 
+  // match.  num_threads = 0 uses all of the hardware threads.  Filters that 
+  // can't pack a bucket and a fingerprint into 64 bits, or inputs of 2^32 or
+  // more keys, fall back to insert_many.
+  NOINLINE bool bulk_load(const keys_t* keys, const uint64_t num_keys, 
+    std::vector<bool>& status, uint32_t num_threads = 0){
+    constexpr uint64_t fingerprint_mask = _fingerprint_len_bits < 64 ? 
+      (1ULL << (_fingerprint_len_bits % 64)) - 1 : ~0ULL;
+    const bool packable = _fingerprint_len_bits < 32 && 
+      (static_cast<uint64_t>(_total_buckets) >> 
+      (64 - _fingerprint_len_bits % 64)) == 0;
+    const uint64_t partitions = (_total_blocks + _bulk_load_partition_blocks 
+      - 1) / _bulk_load_partition_blocks;
+    if(num_threads == 0){
+      num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    num_threads = std::min<uint64_t>(num_threads, partitions);
+
+    _ota_bits_set = 0;
+    std::fill(_block_fullness_array.begin(), _block_fullness_array.end(), 
+      false);
+    clear_stash();
+    _item_count = 0;
+    if(!packable || num_keys >> 32){
+      clear_blocks(0, _total_blocks);
+      const bool all_stored = insert_many_impl(keys, num_keys, status);
+      finish_bulk_load();
+      return all_stored;
+    }
+
+    // Thread t hashes keys [t * keys_per_thread, (t + 1) * keys_per_thread),
+    // which starts on a batch boundary, and writes partitions 
+    // [t * partitions / num_threads, (t + 1) * partitions / num_threads).
+    const uint64_t keys_per_thread = ((num_keys + num_threads - 1) / 
+      num_threads + batch_size - 1) / batch_size * batch_size;
+    auto thread_keys = [&](uint32_t t, uint64_t& first, uint64_t& last){
+      first = std::min(num_keys, t * keys_per_thread);
+      last = std::min(num_keys, first + keys_per_thread);
+    };
+
+    // Pass 1
+    std::vector<std::vector<uint64_t>> offsets(num_threads, 
+      std::vector<uint64_t>(partitions, 0));
+    run_in_parallel(num_threads, [&](uint32_t t){
+      std::vector<uint64_t>& counts = offsets[t];
+      uint64_t first, last;
+      thread_keys(t, first, last);
+      for_each_hashed_key(keys, first, last, [&](hash_t bucket_id, atom_t){
+        counts[bucket_id / _buckets_per_block / _bulk_load_partition_blocks]++;
+      });
+    });
+    // Turn the counts into where each thread writes to each partition
+    std::vector<uint64_t> partition_starts(partitions + 1, 0);
+    uint64_t sum = 0;
+    for(uint64_t p = 0; p < partitions; p++){
+      partition_starts[p] = sum;
+      for(uint32_t t = 0; t < num_threads; t++){
+        const uint64_t count = offsets[t][p];
+        offsets[t][p] = sum;
+        sum += count;
+      }
+    }
+    partition_starts[partitions] = sum;
+
+    // Pass 2
+    // Not a std::vector, which would zero it first
+    std::unique_ptr<uint64_t[]> packed_items(new uint64_t[num_keys]);
+    run_in_parallel(num_threads, [&](uint32_t t){
+      std::vector<uint64_t>& next = offsets[t];
+      uint64_t first, last;
+      thread_keys(t, first, last);
+      for_each_hashed_key(keys, first, last, [&](hash_t bucket_id, 
+        atom_t fingerprint){
+        packed_items[next[bucket_id / _buckets_per_block / 
+          _bulk_load_partition_blocks]++] = (static_cast<uint64_t>(
+          bucket_id) << _fingerprint_len_bits) | fingerprint;
+      });
+    });
+
+    // Pass 3
+    std::vector<std::vector<uint64_t>> set_aside(num_threads);
+    run_in_parallel(num_threads, [&](uint32_t t){
+      std::vector<uint64_t> sorted_items;
+      for(uint64_t p = t * partitions / num_threads; 
+        p < (t + 1) * partitions / num_threads; p++){
+        const uint64_t first_block = p * _bulk_load_partition_blocks;
+        const uint64_t last_block = std::min<uint64_t>(_total_blocks, 
+          first_block + _bulk_load_partition_blocks);
+        const uint64_t* items = &packed_items[partition_starts[p]];
+        const uint64_t count = partition_starts[p + 1] - partition_starts[p];
+        // Counting sort by block.  block_starts[b - first_block] is where 
+        // block b's items start.
+        std::array<uint32_t, _bulk_load_partition_blocks + 1> block_starts{};
+        for(uint64_t i = 0; i < count; i++){
+          block_starts[(items[i] >> _fingerprint_len_bits) / 
+            _buckets_per_block - first_block + 1]++;
+        }
+        std::partial_sum(block_starts.begin(), block_starts.end(), 
+          block_starts.begin());
+        std::array<uint32_t, _bulk_load_partition_blocks> next;
+        std::copy(block_starts.begin(), block_starts.end() - 1, next.begin());
+        sorted_items.resize(count);
+        for(uint64_t i = 0; i < count; i++){
+          sorted_items[next[(items[i] >> _fingerprint_len_bits) / 
+            _buckets_per_block - first_block]++] = items[i];
+        }
+        clear_blocks(first_block, last_block);
+        for(uint64_t block_id = first_block; block_id < last_block; 
+          block_id++){
+          const uint64_t b = block_id - first_block;
+          build_block(block_id, &sorted_items[block_starts[b]], 
+            block_starts[b + 1] - block_starts[b], set_aside[t]);
+        }
+      }
+    });
+
+    // Pass 4
+    if(_block_fullness_array_enabled){
+      for(uint64_t block_id = 0; block_id < _total_blocks; block_id++){
+        _block_fullness_array[block_id] = report_fsa_load(block_id) == 
+          _max_fingerprints_per_block;
+      }
+    }
+    status.assign(num_keys, true);
+    std::unordered_map<uint64_t, uint64_t> failures;
+    uint64_t failure_count = 0;
+    for(uint32_t t = 0; t < num_threads; t++){
+      for(const uint64_t item : set_aside[t]){
+        if(!table_store(item >> _fingerprint_len_bits, 
+          item & fingerprint_mask)){
+          failures[item]++;
+          failure_count++;
+        }
+      }
+    }
+    _item_count = num_keys - failure_count;
+    // Only rehash the keys if some of them couldn't be stored
+    for(uint64_t i = 0; !failures.empty() && i < num_keys; i++){
+      const hash_t raw_hash = raw_primary_hash(keys[i]);
+      const atom_t fingerprint = fingerprint_function(raw_hash);
+      const uint64_t item = (static_cast<uint64_t>(map_to_bucket(raw_hash, 
+        _total_buckets)) << _fingerprint_len_bits) | fingerprint;
+      auto it = failures.find(item);
+      if(it != failures.end()){
+        status[i] = false;
+        if(--it->second == 0){
+          failures.erase(it);
+        }
+      }
+    }
+    finish_bulk_load();
+    return failure_count == 0;
+  }
+
+  // Writes the count packed items (see bulk_load) of the empty block at 
+  // block_id.  Buckets are filled in order, and the items that don't fit in
+  // their bucket or the block are appended to set_aside.  The per-item work 
+  // is branch free because the bucket sizes are too random to predict.
+  NOINLINE void build_block(const hash_t block_id, const uint64_t* items, 
+    const uint64_t count, std::vector<uint64_t>& set_aside){
+    constexpr uint64_t fingerprint_mask = _fingerprint_len_bits < 64 ? 
+      (1ULL << (_fingerprint_len_bits % 64)) - 1 : ~0ULL;
+    std::array<uint16_t, _buckets_per_block> bucket_sizes{};
+    for(uint64_t i = 0; i < count; i++){
+      bucket_sizes[(items[i] >> _fingerprint_len_bits) % _buckets_per_block]++;
+    }
+    // bucket_starts[b] is bucket b's first FSA slot once the buckets before 
+    // it have as many items as fit.  With power-of-2 counters at the start 
+    // of the block, the FCA is put together in registers and copied over.
+    constexpr bool word_counters = _fullness_counters_offset == 0 && 
+      64 % _fullness_counter_width == 0;
+    constexpr uint64_t fca_bits = _buckets_per_block * _fullness_counter_width;
+    std::array<uint16_t, _buckets_per_block> bucket_starts;
+    std::array<uint64_t, (fca_bits + 63) / 64> fca{};
+    uint64_t fsa_slot = 0;
+    for(uint64_t counter_index = 0; counter_index < _buckets_per_block; 
+      counter_index++){
+      const uint64_t placed = std::min<uint64_t>(std::min<uint64_t>(
+        bucket_sizes[counter_index], _slots_per_bucket), 
+        _max_fingerprints_per_block - fsa_slot);
+      bucket_starts[counter_index] = fsa_slot;
+      bucket_sizes[counter_index] = placed;
+      fsa_slot += placed;
+      if(word_counters){
+        const uint64_t bit = counter_index * _fullness_counter_width;
+        fca[bit / 64] |= static_cast<uint64_t>(placed) << (bit % 64);
+      }
+      else{
+        set_fullness_counter(_storage[block_id], counter_index, placed);
+      }
+    }
+    if(word_counters){
+      memcpy(reinterpret_cast<uint8_t*>(&_storage[block_id]), fca.data(), 
+        (fca_bits + 7) / 8);
+    }
+    // One extra slot for the stores of the items that don't fit
+    std::array<atom_t, _max_fingerprints_per_block + 1> fingerprints;
+    std::array<uint16_t, _buckets_per_block> bucket_ranks{};
+    const uint64_t aside = set_aside.size();
+    set_aside.resize(aside + count);
+    uint64_t not_placed = 0;
+    for(uint64_t i = 0; i < count; i++){
+      const uint64_t item = items[i];
+      const uint64_t counter_index = (item >> _fingerprint_len_bits) % 
+        _buckets_per_block;
+      const uint64_t rank = bucket_ranks[counter_index]++;
+      const bool fits = rank < bucket_sizes[counter_index];
+      fingerprints[fits ? bucket_starts[counter_index] + rank : 
+        _max_fingerprints_per_block] = item & fingerprint_mask;
+      set_aside[aside + not_placed] = item;
+      not_placed += !fits;
+    }
+    set_aside.resize(aside + not_placed);
+    // Byte-sized fingerprints are stored directly
+    constexpr bool byte_fingerprints = (_fingerprint_len_bits == 8 || 
+      _fingerprint_len_bits == 16) && _fingerprint_offset % 8 == 0;
+    uint8_t* fsa = reinterpret_cast<uint8_t*>(&_storage[block_id]) + 
+      _fingerprint_offset / 8;
+    for(uint64_t slot = 0; slot < fsa_slot; slot++){
+      if(byte_fingerprints){
+        const uint16_t fingerprint = fingerprints[slot];
+        memcpy(fsa + slot * (_fingerprint_len_bits / 8), &fingerprint, 
+          _fingerprint_len_bits / 8);
+      }
+      else{
+        write_fingerprint(_storage[block_id], slot, fingerprints[slot]);
+      }
+    }
+  }
+
+  // Calls f(bucket_id, fingerprint) for keys [first, last) in order.  first
+  // must be a multiple of batch_size.
+  template<class FUNCTION>
+  NOINLINE void for_each_hashed_key(const keys_t* keys, uint64_t first, 
+    uint64_t last, FUNCTION f) const{
+    for(uint64_t i = first; i < last; i += batch_size){
+      ar_hash bucket_hashes;
+      ar_atom fingerprints;
+      const uint64_t count = std::min(batch_size, last - i);
+      if(count == batch_size){
+        hash_many(&keys[i], bucket_hashes, fingerprints);
+      }
+      else{
+        hash_many_partial(&keys[i], count, bucket_hashes, fingerprints);
+      }
+      for(uint64_t j = 0; j < count; j++){
+        f(bucket_hashes[j], fingerprints[j]);
+      }
+    }
+  }
+
+  // Calls f(t) on num_threads threads, t = 0 on the calling thread
+  template<class FUNCTION>
+  static void run_in_parallel(uint32_t num_threads, FUNCTION f){
+    std::vector<std::thread> threads;
+    for(uint32_t t = 1; t < num_threads; t++){
+      threads.emplace_back(f, t);
+    }
+    f(0);
+    for(std::thread& thread : threads){
+      thread.join();
+    }
+  }
+
+  // Empties blocks [first_block, last_block) in place
+  inline void clear_blocks(uint64_t first_block, uint64_t last_block){
+    memset(static_cast<void*>(&_storage[first_block]), 0, 
+      (last_block - first_block) * sizeof(block_t));
+  }
+
+  // Brings the structures that mirror the table back in sync after 
+  // bulk_load rewrites it
+  NOINLINE void finish_bulk_load(){
+    if(ota_summary_enabled()){
+      for(uint64_t block_id = 0; block_id < _total_blocks; block_id++){
+        _ota_summary[block_id] = read_ota(block_id);
+      }
+    }
+    rebuild_prefilter();
+    clear_hot_key_cache();
+  }
+
+  // Item at a time
+  inline bool insert(const keys_t key){
+    hash_t raw_hash = raw_primary_hash(key);
+    hot_key_cache_invalidate(raw_hash);
+    
+    atom_t fingerprint = fingerprint_function(raw_hash);
+    // Primary bucket
+    hash_t primary_bucket = map_to_bucket(raw_hash, _total_buckets);
+    
+    if(_DEBUG){  // Replace with debug variable
+      std::cout << "Inserting key: " 
+        << key << " "
+        << "Fingerprint: " << fingerprint << " Bucket index: " 
+        << primary_bucket << std::endl;
+      fflush(stdout);
+    }
+    
+    uint8_t* counters;
+    if(_DEBUG){
+      std::cout << "IN DEBUG" << std::endl;
+      counters = new uint8_t[_total_buckets];
+      for(uint64_t i = 0; i < _total_buckets; i++){
+        counters[i] = read_counter(i / _buckets_per_block, 
+          i % _buckets_per_block);
+      }
+    }
+    bool ret = table_store(primary_bucket, fingerprint);
+    _item_count += ret;
+    if(ret && prefilter_enabled()){
+      prefilter_insert(primary_bucket, fingerprint);
+    }
+    if(_DEBUG){
+      for(uint64_t i = 0; i < _total_buckets; i++){
+        atom_t counter_read = read_counter(i / _buckets_per_block, i % _buckets_per_block);
+        if(counters[i] != counter_read && i != primary_bucket){
+          std::cerr << "table_store is corrupting counters.\n" << std::endl;
+          std::cerr << std::flush;
+          exit(1);
+        }
+        else if(i == primary_bucket && counters[i] + 1u != counter_read){
+          std::cerr << "table_store is not properly incrementing counters.\n" 
+            << std::endl;
+          std::cerr << std::flush;
+          exit(1);
+        }
+      }
+      delete[] counters;
+    }
+    return ret;
+  }
+ 
+  // Computes the fingerprints and primary buckets of the batch of keys that 
+  // begins at keys.  Shared by insert_many, likely_contains_many, and 
+  // delete_many.  It processes _HASH_N keys at a time with GCC's vector 
+  // extensions so that the hash, fingerprint, and bucket computations are all 
+  // SIMD.  If raw_hashes isn't null, the raw hashes are stored there too.
+  INLINE void hash_many(const keys_t* keys, ar_hash& bucket_hashes, 
+    ar_atom& fingerprints, hash_t* raw_hashes = nullptr) const{
+    static_assert(batch_size % _HASH_N == 0, 
+      "batch_size must be a multiple of _HASH_N");
+    static_assert(sizeof(atom_t) == sizeof(hash_t), "hash_many stores "
+      "fingerprints with the vector width of hashes");
+    for(hash_t j = 0; j < batch_size; j += _HASH_N){
+      vH_key ks;
+      memcpy(&ks, &keys[j], sizeof(ks));
+      const vH_hash raw_hashes_v = reinterpret_cast<vH_hash>(
+        _hasher.hashN(ks));
+      const vH_hash fps = fingerprint_functionN(raw_hashes_v);
+      const vH_hash buckets = map_to_bucketN(raw_hashes_v, fps, 
+        _total_buckets);
+      memcpy(&fingerprints[j], &fps, sizeof(fps));
+      memcpy(&bucket_hashes[j], &buckets, sizeof(buckets));
+      if(raw_hashes != nullptr){
+        memcpy(&raw_hashes[j], &raw_hashes_v, sizeof(raw_hashes_v));
+      }
+    }
+  }
+
+  // hash_many for the last count < batch_size keys of an input.  The lanes 
+  // past the end repeat the first key.
+  INLINE void hash_many_partial(const keys_t* keys, const uint64_t count, 
+    ar_hash& bucket_hashes, ar_atom& fingerprints, 
+    hash_t* raw_hashes = nullptr) const{
+    ar_key padded_keys;
+    std::copy(keys, keys + count, padded_keys.begin());
+    std::fill(padded_keys.begin() + count, padded_keys.end(), keys[0]);
+    hash_many(padded_keys.data(), bucket_hashes, fingerprints, raw_hashes);
+  }
+
+  // The hot-key result cache is a small direct-mapped table of recent lookup
+  // results for skewed workloads, where a few keys get most of the lookups 
+  // and repeat often enough to still be in it.  An entry is a key's raw hash 
+  // (see raw_primary_hash) with the low bit replaced by the result.  The 
+  // entry's index comes from bits 1 and up of the raw hash, so an entry 
+  // whose index bits don't match its position is empty.  Two keys with the 
+  // same raw hash have the same bucket and fingerprint and thus the same 
+  // result, so the low bit isn't needed for the tag.  Insertions and 
+  // deletions invalidate the entries of their keys, and resizing clears the 
+  // cache.  That doesn't make the answers the same as without the cache, 
+  // though.  Inserting a key B with a different raw hash but the same bucket
+  // and fingerprint as a cached negative key A leaves A's entry alone, so A 
+  // stays negative where the table would now give a false positive, and 
+  // deleting B leaves a false positive cached for A.  Neither can be a false
+  // negative since inserting A itself invalidates A's entry.  
+  // likely_contains and likely_contains_many use it; the other lookups 
+  // bypass it.  Because lookups write to it, concurrent lookups on one 
+  // filter aren't safe with it enabled, even though they're const.
+  INLINE uint64_t hot_key_cache_index(const hash_t raw_hash) const{
+    return (raw_hash >> 1) & (_hot_key_cache_entries - 1);
+  }
+
+  INLINE uint64_t hot_key_cache_empty_entry(const uint64_t index) const{
+    return (index ^ 1) << 1;
+  }
+
+  INLINE bool hot_key_cache_lookup(const hash_t raw_hash, bool& result) const{
+    const uint64_t entry = _hot_key_cache[hot_key_cache_index(raw_hash)];
+    result = entry & 1;
+    return (entry | 1) == (raw_hash | 1);
+  }
+
+  INLINE void hot_key_cache_store(const hash_t raw_hash, const bool result) 
+    const{
+    _hot_key_cache[hot_key_cache_index(raw_hash)] = (raw_hash & ~1ULL) | 
+      result;
+  }
+
+  INLINE void hot_key_cache_invalidate(const hash_t raw_hash){
+    if(_hot_key_cache_enabled){
+      const uint64_t index = hot_key_cache_index(raw_hash);
+      _hot_key_cache[index] = hot_key_cache_empty_entry(index);
+    }
+  }
+
+  // The prefilter's hash of an item with primary bucket bucket_id
+  INLINE uint64_t prefilter_hash(const hash_t bucket_id, 
+    const atom_t fingerprint) const{
+    return _hasher.hash64N<uint64_t>((static_cast<uint64_t>(bucket_id) << 
+      _fingerprint_len_bits) | fingerprint);
+  }
+
+  INLINE void prefilter_insert(const hash_t bucket_id, 
+    const atom_t fingerprint){
+    _prefilter.insert(prefilter_hash(bucket_id, fingerprint));
+  }
+
+  INLINE bool prefilter_contains(const hash_t bucket_id, 
+    const atom_t fingerprint) const{
+    return _prefilter.contains(prefilter_hash(bucket_id, fingerprint));
+  }
+
+  // Prefetches every cache line of the block at block_id
+  INLINE void prefetch_block(const hash_t block_id) const{
+    constexpr uint64_t lines_per_block = (sizeof(block_t) + 
+      g_cache_line_size_bytes - 1) / g_cache_line_size_bytes;
+    const char* block_address = reinterpret_cast<const char*>(
+      &_storage[block_id]);
+    for(uint64_t line = 0; line < lines_per_block; line++){
+      __builtin_prefetch(block_address + line * g_cache_line_size_bytes, 0, 3);
+    }
+  }
+
+  // Prefetches the blocks that contain the buckets in bucket_ids
+  INLINE void prefetch_blocks_many(const ar_hash& bucket_ids) const{
+    for(uint_fast32_t i = 0; i < batch_size; i++){
+      prefetch_block(bucket_ids[i] / _buckets_per_block);
+    }
+  }
+
+  // The OTA summary is a dense array with a copy of each block's OTA, which 
+  // at 16 bits per 512-bit block costs about 3% extra memory and, unlike the 
+  // blocks, stays in the cache.  Batched and split-phase lookups check it 
+  // when they prefetch a key's primary block, and if the key's OTA bit is 
+  // set, they prefetch its secondary block at the same time instead of 
+  // waiting for the primary block to arrive to find out.  That takes one 
+  // dependent DRAM access off of lookups that need the secondary bucket.  It 
+  // only applies to Morton filters, and set_overflow_status and resizing 
+  // keep it in sync.
+  inline void enable_ota_summary(){
+    if(!_morton_filter_functionality_enabled){
+      return;
+    }
+    _ota_summary.resize(_total_blocks);
+    for(uint64_t block_id = 0; block_id < _total_blocks; block_id++){
+      _ota_summary[block_id] = read_ota(block_id);
+    }
+  }
+
+  inline void disable_ota_summary(){
+    std::vector<ota_summary_t>().swap(_ota_summary);
+  }
+
+  inline bool ota_summary_enabled() const{
+    return !_ota_summary.empty();
+  }
+
+  // The prefilter is a cache-line-blocked Bloom filter that sits in front of 
+  // the table for workloads where most lookups are negative.  It holds an 
+  // entry per stored item keyed on the item's primary bucket and 
+  // fingerprint, which is what a lookup has in hand right after hashing.
+  // likely_contains and the likely_contains_many family check it first, and 
+  // the keys that it rejects never touch _storage.  The partitioned, 
+  // split-phase, and interleaved lookups don't use it.  Insertions add to 
+  // it.  Deletions can't remove from it, so it accumulates stale entries 
+  // until rebuild_prefilter is called.  Stale entries only cost lookups that
+  // then go to the table.
+  //
+  // The prefilter never adds false negatives or false positives.  A lookup 
+  // that it passes gets the filter's answer, and one that it rejects has no 
+  // stored item with its primary bucket and fingerprint, so the filter could
+  // at most have matched an item whose primary bucket is the lookup's 
+  // secondary bucket, which would have been a false positive.  The combined 
+  // false positive ratio is thus slightly below the filter's own.  The 
+  // prefilter's false positive ratio, epsilon_p, decides how many negatives 
+  // still go to the table: a fraction epsilon_p of them.  With 3 hash 
+  // probes per key, epsilon_p is about 4% with 8 bits of prefilter per 
+  // stored item, 15% with 4 bits, and 50% with 2 bits.
+  //
+  // Lookups that consult the prefilter also update prefilter_lookups and 
+  // prefilter_rejections.  The counters are relaxed atomics, so concurrent 
+  // lookups don't race on them, but they may then undercount.
+  //
+  // size_bytes defaults to half of the L3 (or g_default_l3_cache_size_bytes 
+  // if it can't be detected) but no more than 8 bits per slot.  A prefilter 
+  // that doesn't fit in the cache saves little since each lookup then misses
+  // on it instead.
+  inline void enable_prefilter(uint64_t size_bytes = 0){
+    if(size_bytes == 0){
+      size_bytes = std::min<uint64_t>(util::detect_cache_size_bytes(3, 
+        g_default_l3_cache_size_bytes) / 2, _total_slots);
+    }
+    _prefilter.allocate(size_bytes);
+    rebuild_prefilter();
+  }
+
+  inline void disable_prefilter(){
+    _prefilter.release();
+  }
+
+  inline bool prefilter_enabled() const{
+    return _prefilter.allocated();
+  }
+
+  inline uint64_t prefilter_size_bytes() const{
+    return _prefilter.size_bytes();
+  }
+
+  // Rebuilds the prefilter from the fingerprints in the table, which drops 
+  // the entries of deleted items.  The table doesn't record whether an item 
+  // is in its primary or its secondary bucket, so an item is entered under 
+  // the bucket that it's in and, if it could have overflowed from the 
+  // other candidate bucket, under that one too.  For Morton filters, that's 
+  // only when the other bucket's OTA bit is set.  Compressed cuckoo filters
+  // have no OTA, so every item gets two entries.
+  NOINLINE void rebuild_prefilter(){
+    if(!prefilter_enabled()){
+      return;
+    }
+    _prefilter.clear();
+    for(uint64_t block_id = 0; block_id < _total_blocks; block_id++){
+      uint64_t fsa_index = 0;
+      for(uint64_t counter_index = 0; counter_index < _buckets_per_block;
+        counter_index++){
+        const counter_t fullness_counter = read_counter(block_id, 
+          counter_index);
+        for(uint64_t slot_id = 0; slot_id < fullness_counter; slot_id++, 
+          fsa_index++){
+          const hash_t bucket_id = block_id * _buckets_per_block + 
+            counter_index;
+          const atom_t fingerprint = read_fingerprint(block_id, fsa_index);
+          prefilter_insert(bucket_id, fingerprint);
+          if(!_remap_enabled){
+            continue;
+          }
+          const hash_t other_bucket_id = determine_alternate_bucket(bucket_id,
+            fingerprint);
+          if(!_morton_filter_functionality_enabled || 
+            get_overflow_status(other_bucket_id, fingerprint)){
+            prefilter_insert(other_bucket_id, fingerprint);
+          }
+        }
+      }
+    }
+    // Stashed items have entries under both of their buckets
+    for(const stash_entry_t& entry : _stash){
+      prefilter_insert(entry.first, entry.second);
+    }
+    _prefilter_stale_deletions = 0;
+  }
+
+  // Lookups that consulted the prefilter and those that it rejected.  
+  // Each rejection is a lookup that didn't read its primary block (nor its
+  // secondary block if its OTA bit would have been set).
+  inline uint64_t prefilter_lookups() const{
+    return _prefilter_lookups.load(std::memory_order_relaxed);
+  }
+
+  inline uint64_t prefilter_rejections() const{
+    return _prefilter_rejections.load(std::memory_order_relaxed);
+  }
+
+  inline void reset_prefilter_counters(){
+    _prefilter_lookups.store(0, std::memory_order_relaxed);
+    _prefilter_rejections.store(0, std::memory_order_relaxed);
+  }
+
+  // A relaxed load and store rather than a fetch_add, which would be a 
+  // locked instruction on every single-key lookup.  That makes concurrent 
+  // lookups race-free, but two of them that update a counter at the same 
+  // time can lose one of the updates.  The counters are statistics, so I'd 
+  // rather keep lookups fast.
+  INLINE void count_prefilter_lookups(const uint64_t lookups, 
+    const uint64_t rejections) const{
+    _prefilter_lookups.store(_prefilter_lookups.load(
+      std::memory_order_relaxed) + lookups, std::memory_order_relaxed);
+    _prefilter_rejections.store(_prefilter_rejections.load(
+      std::memory_order_relaxed) + rejections, std::memory_order_relaxed);
+  }
+
+  // Successful deletions since the prefilter was last rebuilt, i.e., an upper
+  // bound on its stale entries.  Use it to decide when to rebuild.
+  inline uint64_t prefilter_stale_deletions() const{
+    return _prefilter_stale_deletions;
+  }
+
+  // Lookups that consulted the hot-key cache and those that it answered.  
+  // Both stay 0 unless t_hot_key_cache_entries is set.
+  inline uint64_t hot_key_cache_lookups() const{
+    return _hot_key_cache_lookups;
+  }
+
+  inline uint64_t hot_key_cache_hits() const{
+    return _hot_key_cache_hits;
+  }
+
+  inline double hot_key_cache_hit_ratio() const{
+    return _hot_key_cache_lookups == 0 ? 0.0 : 
+      static_cast<double>(_hot_key_cache_hits) / _hot_key_cache_lookups;
+  }
+
+  inline void reset_hot_key_cache_counters(){
+    _hot_key_cache_lookups = 0;
+    _hot_key_cache_hits = 0;
+  }
+
+  inline void clear_hot_key_cache(){
+    for(uint64_t i = 0; i < _hot_key_cache.size(); i++){
+      _hot_key_cache[i] = hot_key_cache_empty_entry(i);
+    }
+  }
+
+  // The overflow stash holds up to _stash_capacity items that the table 
+  // couldn't place, so inserts keep succeeding at loads where the cuckoo 
+  // path search gives up.  The table doesn't know whether a stashed item 
+  // belongs to the bucket that it failed on or to the other one (random 
+  // kickouts stash whatever fingerprint they're left holding), so with 
+  // remapping each item gets an entry under both of its candidate buckets, 
+  // and lookups only have to check the primary bucket's.  The entries are 
+  // kept sorted for binary search.  Lookups first check the bitmap of 
+  // bucket-prefix tags, so when the stash is empty (the common case) or has
+  // nothing near the key, they don't touch the entries.  Deletions that free
+  // space in a block move the stashed items that belong there back into the
+  // table (see drain_stash).
+
+  // Number of items in the overflow stash
+  inline uint64_t stash_size() const{
+    return _stash.size() / _stash_entries_per_item;
+  }
+
+  inline bool stash_nonempty() const{
+    return _stash_nonempty;
+  }
+
+  INLINE bool stash_tag_is_set(const hash_t bucket_id) const{
+    const hash_t tag = bucket_id >> _stash_tag_shift;
+    return (_stash_tags[tag / 64] >> (tag % 64)) & 1;
+  }
+
+  INLINE void set_stash_tag(const hash_t bucket_id){
+    const hash_t tag = bucket_id >> _stash_tag_shift;
+    _stash_tags[tag / 64] |= 1ULL << (tag % 64);
+  }
+
+  // Sets _stash_tag_shift so that every bucket id has a tag of at most 
+  // stash_prefix_tag_len bits and sizes the tag bitmap to match, so small 
+  // filters get small bitmaps.  Call it when _total_buckets changes.
+  NOINLINE void update_stash_tag_shift(){
+    const uint64_t bucket_id_bits = _total_buckets <= 1 ? 0 : 
+      64 - __builtin_clzll(static_cast<uint64_t>(_total_buckets) - 1);
+    _stash_tag_shift = bucket_id_bits > stash_prefix_tag_len ? 
+      bucket_id_bits - stash_prefix_tag_len : 0;
+    _stash_tags.resize(((1ULL << (bucket_id_bits - _stash_tag_shift)) + 63) / 
+      64);
+    update_stash_tags();
+  }
+
+  NOINLINE void update_stash_tags(){
+    std::fill(_stash_tags.begin(), _stash_tags.end(), 0);
+    for(const stash_entry_t& entry : _stash){
+      set_stash_tag(entry.first);
+    }
+    _stash_nonempty = !_stash.empty();
+  }
+
+  NOINLINE void clear_stash(){
+    _stash.clear();
+    update_stash_tags();
+  }
+
+  NOINLINE void stash_add_entry(const hash_t bucket_id, 
+    const atom_t fingerprint){
+    const stash_entry_t entry(bucket_id, fingerprint);
+    _stash.insert(std::upper_bound(_stash.begin(), _stash.end(), entry), 
+      entry);
+    set_stash_tag(bucket_id);
+    _stash_nonempty = true;
+  }
+
+  // Removes one copy of the entry, which must be there, and returns the 
+  // index that it was at
+  NOINLINE uint64_t stash_remove_entry(const hash_t bucket_id, 
+    const atom_t fingerprint){
+    const uint64_t index = std::lower_bound(_stash.begin(), _stash.end(), 
+      stash_entry_t(bucket_id, fingerprint)) - _stash.begin();
+    _stash.erase(_stash.begin() + index);
+    return index;
+  }
+
+  // Stashes fingerprint, which belongs to bucket_id or (with remapping) its 
+  // alternate.  Returns false if the stash is full.
+  NOINLINE bool stash_insert(const hash_t bucket_id, const atom_t fingerprint){
+    if(_stash.size() >= _stash_capacity * _stash_entries_per_item){
+      return false;
+    }
+    stash_add_entry(bucket_id, fingerprint);
+    if(_remap_enabled){
+      stash_add_entry(determine_alternate_bucket(bucket_id, fingerprint), 
+        fingerprint);
+    }
+    return true;
+  }
+
+  // Whether the item with this primary bucket and fingerprint is stashed
+  INLINE bool stash_contains(const hash_t bucket_id, 
+    const atom_t fingerprint) const{
+    if(__builtin_expect(!_stash_nonempty || !stash_tag_is_set(bucket_id), 
+      1)){
+      return false;
+    }
+    return stash_search(bucket_id, fingerprint);
+  }
+
+  NOINLINE bool stash_search(const hash_t bucket_id, 
+    const atom_t fingerprint) const{
+    return std::binary_search(_stash.begin(), _stash.end(), 
+      stash_entry_t(bucket_id, fingerprint));
+  }
+
+  // Sets bit i of found if key i of the batch is stashed
+  INLINE void stash_read_and_compare_many(const ar_hash& bucket_ids, 
+    const ar_atom& fingerprints, ar_bitmap& found) const{
+    if(__builtin_expect(!stash_nonempty(), 1)){
+      return;
+    }
+    // Branch-free pass over the tags, a word at a time so that the bits 
+    // accumulate in a register, then search only for the keys that weren't
+    // found in the table and whose tags are set
+    for(uint_fast32_t w = 0; w < batch_bitmap_words; w++){
+      uint64_t candidates = 0;
+      const uint_fast32_t first = w * 64;
+      const uint_fast32_t last = std::min<uint_fast32_t>(first + 64, 
+        batch_size);
+      for(uint_fast32_t i = first; i < last; i++){
+        candidates |= static_cast<uint64_t>(stash_tag_is_set(bucket_ids[i])) 
+          << (i - first);
+      }
+      for(uint64_t bits = candidates & ~found[w]; bits != 0; 
+        bits &= bits - 1){
+        const uint_fast32_t i = w * 64 + __builtin_ctzll(bits);
+        set_batch_bit(found, i, stash_search(bucket_ids[i], 
+          fingerprints[i]));
+      }
+    }
+  }
+
+  // Removes the item with this primary bucket and fingerprint from the 
+  // stash if it's there
+  NOINLINE bool stash_delete(const hash_t bucket_id, const atom_t fingerprint){
+    if(!stash_contains(bucket_id, fingerprint)){
+      return false;
+    }
+    stash_remove_entry(bucket_id, fingerprint);
+    if(_remap_enabled){
+      stash_remove_entry(determine_alternate_bucket(bucket_id, fingerprint), 
+        fingerprint);
+    }
+    update_stash_tags();
+    return true;
+  }
+
+  // Moves the stashed items with an entry in block_id into the table while 
+  // the block has room for them.  The stash doesn't know which of an item's
+  // buckets is its primary, so when an item goes into bucket x, x's 
+  // alternate bucket gets its OTA bit set in case x is the secondary.  It 
+  // costs a binary search when none of the stashed items belong to the 
+  // block.
+  INLINE void drain_stash(const hash_t block_id){
+    if(__builtin_expect(stash_nonempty(), 0)){
+      drain_stash_into_block(block_id);
+    }
+  }
+
+  NOINLINE void drain_stash_into_block(const hash_t block_id){
+    const hash_t first_bucket_id = block_id * _buckets_per_block;
+    uint64_t i = std::lower_bound(_stash.begin(), _stash.end(), 
+      stash_entry_t(first_bucket_id, 0)) - _stash.begin();
+    bool drained = false;
+    while(i < _stash.size() && 
+      _stash[i].first < first_bucket_id + _buckets_per_block){
+      const hash_t bucket_id = _stash[i].first;
+      const atom_t fingerprint = _stash[i].second;
+      StoreParams sp;
+      if(!first_level_store(bucket_id, fingerprint, sp)){
+        i++;
+        continue;
+      }
+      _stash.erase(_stash.begin() + i);
+      if(_remap_enabled){
+        const hash_t other_bucket_id = determine_alternate_bucket(bucket_id, 
+          fingerprint);
+        if(_morton_filter_functionality_enabled){
+          set_overflow_status(other_bucket_id, fingerprint, 
+            other_bucket_id / _buckets_per_block, 
+            other_bucket_id % _buckets_per_block);
+        }
+        // The other entry may have been before this one
+        i -= stash_remove_entry(other_bucket_id, fingerprint) < i;
+      }
+      drained = true;
+    }
+    if(drained){
+      update_stash_tags();
+    }
+  }
+
+  // Tries to drain the stash into every block that it has entries for
+  NOINLINE void drain_whole_stash(){
+    std::vector<hash_t> block_ids;
+    for(const stash_entry_t& entry : _stash){
+      block_ids.push_back(entry.first / _buckets_per_block);
+    }
+    block_ids.erase(std::unique(block_ids.begin(), block_ids.end()), 
+      block_ids.end());
+    for(hash_t block_id : block_ids){
+      drain_stash(block_id);
+    }
+  }
+
+  // Number of items in the filter, stashed ones included.  It's a running 
+  // count that inserts, deletes, bulk_load, and resize keep up to date, so 
+  // it's O(1).
+  inline uint64_t size() const{
+    return _item_count;
+  }
+
+  // Fraction of the filter's fingerprint slots that are in use.  It's O(1) 
+  // since it comes from a running count of the items.  Stashed items count 
+  // as well.  Apart from those, it's what report_block_occupancy returns 
+  // without scanning the table.
+  inline double load_factor() const{
+    return static_cast<double>(_item_count) / 
+      (_max_fingerprints_per_block * _total_blocks);
+  }
+
+  // Overrides the insertion method (see _default_insertion_method)
+  inline void set_insertion_method(InsertionMethodEnum insertion_method){
+    _insertion_method = insertion_method;
+  }
+
+  // Sets the load factors at which ADAPTIVE goes from first-fit to 
+  // FIRST_FIT_OPT's second stage and from that to two-choice.  
+  // HYBRID_PIECEWISE and FIRST_FIT_OPT switch at first_fit_max_load.  
+  // Passing the same value twice skips the middle stage.
+  inline void set_insertion_load_thresholds(double first_fit_max_load, 
+    double first_fit_opt_max_load){
+    if(!(0.0 <= first_fit_max_load && 
+      first_fit_max_load <= first_fit_opt_max_load)){
+      std::cerr << "ERROR: Insertion load thresholds must satisfy 0 <= " << 
+        "first_fit_max_load <= first_fit_opt_max_load\n";
+      exit(1);
+    }
+    _first_fit_max_load = first_fit_max_load;
+    _first_fit_opt_max_load = first_fit_opt_max_load;
+  }
+
+  // Returns how insert_many stores the batch that starts at key key_index 
+  // of the call: FIRST_FIT, TWO_CHOICE, or FIRST_FIT_OPT, which here means 
+  // its second stage (see table_store_many_two_choice).  The load-based 
+  // methods look at the load factor before the batch, so it's always up to
+  // date to within a batch.
+  inline InsertionMethodEnum select_insertion_method(
+    const uint64_t key_index) const{
+    const double load = load_factor();
+    switch(_insertion_method){
+      // Differs from hybrid approach in only several lines of code
+      case InsertionMethodEnum::HYBRID_PIECEWISE:
+        return load < _first_fit_max_load ? InsertionMethodEnum::FIRST_FIT :
+          InsertionMethodEnum::TWO_CHOICE;
+      case InsertionMethodEnum::FIRST_FIT_OPT:
+        return load < _first_fit_max_load ? InsertionMethodEnum::FIRST_FIT :
+          InsertionMethodEnum::FIRST_FIT_OPT;
+      case InsertionMethodEnum::HYBRID_SIMPLE:{
+        // Two-choice for every cutoff_divisor-th batch
+        constexpr hash_t cutoff_divisor = 3;
+        return key_index % (cutoff_divisor * batch_size) != 0 ? 
+          InsertionMethodEnum::FIRST_FIT : InsertionMethodEnum::TWO_CHOICE;
+      }
+      case InsertionMethodEnum::ADAPTIVE:
+        if(load < _first_fit_max_load){
+          return InsertionMethodEnum::FIRST_FIT;
+        }
+        return load < _first_fit_opt_max_load ? 
+          InsertionMethodEnum::FIRST_FIT_OPT : InsertionMethodEnum::TWO_CHOICE;
+      default: // FIRST_FIT and TWO_CHOICE
+        return _insertion_method;
+    }
+  }
+
+  // Overrides the adaptive choice of lookup kernel.  Pass 
+  // LookupKernelEnum::ADAPTIVE to go back to choosing it per call.
+  inline void set_lookup_kernel(LookupKernelEnum lookup_kernel){
+    _lookup_kernel = lookup_kernel;
+  }
+
+  // Overrides the detected size of the L2 cache
+  inline void set_l2_cache_size_bytes(uint64_t l2_cache_size_bytes){
+    _l2_cache_size_bytes = l2_cache_size_bytes;
+  }
+
+  // Bounds the cuckoo path search that insertions fall back on when neither 
+  // of an item's blocks has room and moving one item doesn't help.  Paths 
+  // are at most max_depth moves long and each level of the search looks at 
+  // up to max_breadth blocks, so an insertion reads at most about 
+  // max_depth * max_breadth blocks.  Bigger bounds fail less often close to
+  // 100% load but make the slowest insertions slower.  A max_depth of 0 goes
+  // back to random kickouts, which move up to 300 fingerprints one after 
+  // another and lose one if they don't find room.
+  inline void set_cuckoo_path_search_bounds(uint_fast16_t max_depth, 
+    uint_fast16_t max_breadth){
+    if(max_depth > 0 && max_breadth < 2){
+      std::cerr << "ERROR: The cuckoo path search needs a breadth of at least"
+        << " 2\n";
+      exit(1);
+    }
+    _cuckoo_path_max_depth = max_depth;
+    _cuckoo_path_max_breadth = max_breadth;
+    const uint64_t max_nodes = 2 + static_cast<uint64_t>(max_depth) * 
+      max_breadth;
+    _cuckoo_path_nodes.reserve(max_nodes);
+    // At most half full
+    uint64_t visited_set_size = 1;
+    while(visited_set_size < 2 * max_nodes){
+      visited_set_size <<= 1;
+    }
+    _cuckoo_path_visited_blocks.assign(visited_set_size, 0);
+  }
+
+  // Fraction of the OTA bits that are set.  Unlike report_ota_occupancy, it's
+  // O(1) and doesn't touch the table.
+  inline double ota_saturation() const{
+    return _ota_len_bits == 0 ? 0.0 : 
+      static_cast<double>(_ota_bits_set) / (_total_blocks * _ota_len_bits);
+  }
+
+  // A variant of equation (5) in the VLDB'18 paper.  ota_occupancy is the 
+  // fraction of negative lookups that also check the secondary bucket, and 
+  // logical_load_factor is the fraction of the logical slots (buckets times
+  // slots per bucket) that are full.  Each resize takes a bit away from the 
+  // part of the fingerprint that's compared.
+  inline double false_positive_ratio(double ota_occupancy, 
+    double logical_load_factor) const{
+    double buckets_accessed_per_negative_lookup = 1 + ota_occupancy;
+    double epsilon = 1.0 - pow(1.0 - 1.0/(1ULL << (_fingerprint_len_bits - 
+      _resize_count)), 
+      logical_load_factor * buckets_accessed_per_negative_lookup * 
+      _slots_per_bucket);
+    return epsilon;
+  }
+
+  // Estimated false positive ratio of the table.  It uses the item count and
+  // the count of OTA bits set (see ota_saturation) rather than scanning the 
+  // table, so it's cheap enough to poll.  Like likely_contains, it assumes 
+  // that only the primary bucket is checked without remapping and that 
+  // compressed cuckoo filters always check both buckets with it.  OTA bits 
+  // aren't cleared by deletions, so after many of them it errs on the high
+  // side.
+  inline double estimated_fpr() const{
+    const double secondary_bucket_ratio = !_remap_enabled ? 0.0 : 
+      (_morton_filter_functionality_enabled ? ota_saturation() : 1.0);
+    return false_positive_ratio(secondary_bucket_ratio, 
+      load_factor() * report_compression_ratio());
+  }
+
+  // Returns the kernel that the batched lookups use for a call with 
+  // num_keys keys.  Unless overridden, calls with only a few keys are done 
+  // one key at a time.  Otherwise, the OTA-gated batch kernel is used unless 
+  // the filter doesn't fit in the L2 and most lookups would need both 
+  // blocks anyway, either because the OTAs are saturated or because it's a 
+  // compressed cuckoo filter, which always reads both, in which case both 
+  // blocks are prefetched up front.  I compare against the L2 rather than 
+  // the LLC because that's where I measured the crossover: a CCF3_8 that 
+  // fits in the L2 was about 10% slower prefetching both blocks, while one 
+  // of 6 MB in a 300 MB L3 was already faster, and 25-50% faster past that.
+  inline LookupKernelEnum select_lookup_kernel(const uint64_t num_keys) const{
+    if(_lookup_kernel != LookupKernelEnum::ADAPTIVE){
+      return _lookup_kernel;
+    }
+    if(num_keys < _adaptive_item_at_a_time_max_keys){
+      return LookupKernelEnum::ITEM_AT_A_TIME;
+    }
+    const bool l2_resident = _total_blocks * sizeof(block_t) <= 
+      _l2_cache_size_bytes;
+    const bool ota_saturated = !_morton_filter_functionality_enabled || 
+      _ota_bits_set * 100 >= _adaptive_prefetch_both_min_ota_percent * 
+      _total_blocks * _ota_len_bits;
+    if(_remap_enabled && !l2_resident && ota_saturated){
+      return LookupKernelEnum::BATCHED_PREFETCH_BOTH;
+    }
+    return LookupKernelEnum::BATCHED_OTA_GATED;
+  }
+
+  // Runs the batched lookups with the kernel that select_lookup_kernel picks.
+  // The results of each batch are handed to output (see batch_output.h).
+  template<class OUTPUT>
+  inline void likely_contains_many_impl(const keys_t* keys, 
+    const uint64_t num_keys, OUTPUT& output) const{
+    const LookupKernelEnum kernel = select_lookup_kernel(num_keys);
+    if((_hot_key_cache_enabled || prefilter_enabled()) && 
+      kernel != LookupKernelEnum::ITEM_AT_A_TIME){
+      likely_contains_many_compacted(keys, num_keys, output);
+      return;
+    }
+    switch(kernel){
+      case LookupKernelEnum::ITEM_AT_A_TIME:
+        likely_contains_many_item_at_a_time(keys, num_keys, output);
+        break;
+      case LookupKernelEnum::BATCHED_PREFETCH_BOTH:
+        likely_contains_many_pipelined<true>(keys, num_keys, output);
+        break;
+      default:
+        likely_contains_many_pipelined<false>(keys, num_keys, output);
+        break;
+    }
+  }
+
+  template<class OUTPUT>
+  NOINLINE void likely_contains_many_item_at_a_time(const keys_t* keys, 
+    const uint64_t num_keys, OUTPUT& output) const{
+    for(hash_t i = 0; i < num_keys; i += batch_size){
+      const uint64_t count = std::min<uint64_t>(batch_size, num_keys - i);
+      ar_bitmap found;
+      found.fill(0);
+      for(uint64_t j = 0; j < count; j++){
+        set_batch_bit(found, j, likely_contains(keys[i + j]));
+      }
+      output.write(i, found, count);
+    }
+  }
+
+  // Prefetches the blocks of the alternate buckets of a batch
+  INLINE void prefetch_alternate_blocks_many(const ar_hash& bucket_ids, 
+    const ar_atom& fingerprints) const{
+    for(uint_fast32_t i = 0; i < batch_size; i++){
+      prefetch_block(determine_alternate_bucket(bucket_ids[i], 
+        fingerprints[i]) / _buckets_per_block);
+    }
+  }
+
+  // Prefetches the secondary blocks of the keys whose OTA bits are set in 
+  // the OTA summary, i.e., the ones that might need a secondary lookup
+  INLINE void prefetch_flagged_alternate_blocks_many(const ar_hash& bucket_ids,
+    const ar_atom& fingerprints) const{
+    // Branch-free since the flags are close to random.  Unflagged keys 
+    // re-prefetch their primary block, which is already on its way.
+    for(uint_fast32_t i = 0; i < batch_size; i++){
+      const bool flagged = get_overflow_status<true>(bucket_ids[i], 
+        fingerprints[i]);
+      const hash_t bucket_id = flagged ? determine_alternate_bucket(
+        bucket_ids[i], fingerprints[i]) : bucket_ids[i];
+      prefetch_block(bucket_id / _buckets_per_block);
+    }
+  }
+
+  // Prefetches the blocks that lookups of a hashed batch will need as far 
+  // as we can tell without touching the table.  If the OTA summary is 
+  // enabled, it also prefetches the batch's OTA summary entries.  The summary
+  // is only ~3% the size of the table, but that can still be bigger than the
+  // L2, so checking it right away would stall on it.  Instead, the caller 
+  // checks it with prefetch_flagged_alternate_blocks_many a bit later, right 
+  // before it compares the batch, which still leaves the whole primary pass
+  // for the secondary blocks to arrive.
+  INLINE void prefetch_lookup_blocks_many(const ar_hash& bucket_ids,
+    const ar_atom& fingerprints, bool prefetch_alternates) const{
+    prefetch_blocks_many(bucket_ids);
+    if(prefetch_alternates){
+      prefetch_alternate_blocks_many(bucket_ids, fingerprints);
+    }
+    else if(ota_summary_enabled()){
+      for(uint_fast32_t i = 0; i < batch_size; i++){
+        __builtin_prefetch(&_ota_summary[bucket_ids[i] / _buckets_per_block], 
+          0, 3);
+      }
+    }
+  }
+
+  // Lookups are software pipelined.  The keys of the batch that is 
+  // _lookup_prefetch_distance batches ahead are hashed and their primary 
+  // blocks prefetched (and their alternate blocks too if 
+  // t_prefetch_alternates) before the current batch is compared.  With the 
+  // OTA summary, the alternate blocks that it says might be needed are 
+  // prefetched just before the batch is compared.  The hashed batches live 
+  // in a small ring buffer so that each batch is only hashed once.
+  template<bool t_prefetch_alternates, class OUTPUT>
+  NOINLINE void likely_contains_many_pipelined(const keys_t* keys, 
+    const uint64_t num_keys, OUTPUT& output) const{
+    constexpr uint_fast16_t stages = _lookup_prefetch_distance + 1;
+    ar_hash bucket_hashes[stages];
+    ar_atom fingerprints[stages];
+    // Prologue: fill the pipeline
+    for(uint_fast16_t s = 0; s < _lookup_prefetch_distance && 
+      (s + 1) * batch_size <= num_keys; s++){
+      hash_many(&keys[s * batch_size], bucket_hashes[s], fingerprints[s]);
+      prefetch_lookup_blocks_many(bucket_hashes[s], fingerprints[s], 
+        t_prefetch_alternates);
+    }
+    uint_fast16_t stage = 0;
+    for(hash_t i = 0; i + batch_size <= num_keys; i += batch_size){
+      const hash_t ahead = i + _lookup_prefetch_distance * batch_size;
+      if(ahead + batch_size <= num_keys){
+        const uint_fast16_t ahead_stage = (stage + _lookup_prefetch_distance) 
+          % stages;
+        hash_many(&keys[ahead], bucket_hashes[ahead_stage], 
+          fingerprints[ahead_stage]);
+        if(_lookup_prefetch_distance > 0){
+          prefetch_lookup_blocks_many(bucket_hashes[ahead_stage], 
+            fingerprints[ahead_stage], t_prefetch_alternates);
+        }
+      }
+      if(!t_prefetch_alternates && ota_summary_enabled()){
+        prefetch_flagged_alternate_blocks_many(bucket_hashes[stage], 
+          fingerprints[stage]);
+      }
+      ar_bitmap found;
+      table_read_and_compare_many(bucket_hashes[stage], fingerprints[stage], 
+        found); 
+      output.write(i, found, batch_size);
+      stage = (stage + 1) % stages;
+    }
+
+    // Partial batch.  The lanes past the end repeat the first remaining key,
+    // and the output policy ignores their results.
+    const uint64_t tail = num_keys % batch_size;
+    if(tail){
+      const hash_t i = num_keys - tail;
+      hash_many_partial(&keys[i], tail, bucket_hashes[0], fingerprints[0]);
+      ar_bitmap found;
+      table_read_and_compare_many(bucket_hashes[0], fingerprints[0], found); 
+      output.write(i, found, tail);
+    }
+  }
+
+  // Batched lookups with the prefilter and/or the hot-key cache.  The keys 
+  // are processed in windows of _compacted_window_batches batches.  Each 
+  // batch of a window is hashed (prefetching its prefilter lines) and then, 
+  // one batch later, looked up in the hot-key cache and checked against the 
+  // prefilter.  The keys that neither answers are compacted in place into 
+  // staged batches, and only those are probed, so the table isn't touched 
+  // for the others and their lanes don't cost any compare work.  Staged 
+  // batches are pipelined like in likely_contains_many_pipelined: as each 
+  // one fills up, its blocks are prefetched and the one 
+  // _lookup_prefetch_distance batches before it is compared.  The results 
+  // are scattered into a bitmap for the window, which goes to output one 
+  // batch at a time and in order.
+  template<class OUTPUT>
+  NOINLINE void likely_contains_many_compacted(const keys_t* keys, 
+    const uint64_t num_keys, OUTPUT& output) const{
+    constexpr uint64_t window_keys = _compacted_window_batches * batch_size;
+    constexpr uint64_t raw_hash_batches = _hot_key_cache_enabled ? 
+      _compacted_window_batches : 1;
+    const bool prefilter = prefilter_enabled();
+    ar_hash bucket_hashes[_compacted_window_batches];
+    ar_atom fingerprints[_compacted_window_batches];
+    ar_hash raw_hashes[raw_hash_batches];
+    uint16_t staged_indexes[window_keys];
+    uint64_t results[window_keys / 64 + batch_bitmap_words + 1];
+    for(uint64_t w = 0; w < num_keys; w += window_keys){
+      const uint64_t window_count = std::min(window_keys, num_keys - w);
+      const uint64_t window_batches = (window_count + batch_size - 1) / 
+        batch_size;
+      std::fill(results, results + sizeof(results) / sizeof(results[0]), 0);
+      // Keys [0, staged) of the window need the table.  Staged batches 
+      // before prefetched have had their blocks prefetched, and those before
+      // compared have been compared.
+      uint64_t staged = 0, prefetched = 0, compared = 0, cache_hits = 0;
+      auto compare_next = [&](){
+        const uint64_t c = compared / batch_size;
+        const uint64_t count = std::min(batch_size, staged - compared);
+        if(ota_summary_enabled()){
+          prefetch_flagged_alternate_blocks_many(bucket_hashes[c], 
+            fingerprints[c]);
+        }
+        ar_bitmap found;
+        table_read_and_compare_many(bucket_hashes[c], fingerprints[c], found);
+        for(uint_fast32_t j = 0; j < count; j++){
+          const uint16_t index = staged_indexes[compared + j];
+          const bool result = get_batch_bit(found, j);
+          results[index / 64] |= static_cast<uint64_t>(result) << (index % 64);
+          if(_hot_key_cache_enabled){
+            hot_key_cache_store(raw_hashes[index / batch_size][
+              index % batch_size], result);
+          }
+        }
+        compared += count;
+      };
+      for(uint64_t b = 0; b <= window_batches; b++){
+        if(b < window_batches){
+          const uint64_t i = b * batch_size;
+          hash_t* raw = _hot_key_cache_enabled ? raw_hashes[b].data() : 
+            nullptr;
+          if(i + batch_size <= window_count){
+            hash_many(&keys[w + i], bucket_hashes[b], fingerprints[b], raw);
+          }
+          else{
+            hash_many_partial(&keys[w + i], window_count - i, 
+              bucket_hashes[b], fingerprints[b], raw);
+          }
+          for(uint_fast32_t j = 0; prefilter && j < batch_size; j++){
+            _prefilter.prefetch(prefilter_hash(bucket_hashes[b][j], 
+              fingerprints[b][j]));
+          }
+        }
+        if(b == 0){
+          continue;
+        }
+        // Check the previous batch and then compact it.  The checks go first
+        // so that the cache and prefilter reads don't wait on the 
+        // compaction's stores.  The compaction is branch free, and its write
+        // position never passes the read position, so it can be done in 
+        // place.
+        const uint64_t first = (b - 1) * batch_size;
+        const uint64_t last = std::min(first + batch_size, window_count);
+        ar_bitmap passed;
+        passed.fill(0);
+        for(uint_fast32_t j = 0; j < last - first; j++){
+          bool hit = false;
+          if(_hot_key_cache_enabled){
+            bool result;
+            hit = hot_key_cache_lookup(raw_hashes[b - 1][j], result);
+            results[(first + j) / 64] |= static_cast<uint64_t>(hit & result)
+              << ((first + j) % 64);
+            cache_hits += hit;
+          }
+          set_batch_bit(passed, j, !hit && (!prefilter || prefilter_contains(
+            bucket_hashes[b - 1][j], fingerprints[b - 1][j])));
+        }
+        for(uint64_t i = first; i < last; i++){
+          const hash_t bucket_id = bucket_hashes[b - 1][i - first];
+          const atom_t fingerprint = fingerprints[b - 1][i - first];
+          bucket_hashes[staged / batch_size][staged % batch_size] = bucket_id;
+          fingerprints[staged / batch_size][staged % batch_size] = fingerprint;
+          staged_indexes[staged] = i;
+          staged += get_batch_bit(passed, i - first);
+        }
+        const bool drain = b == window_batches;
+        while(prefetched + batch_size <= staged || 
+          (drain && prefetched < staged)){
+          const uint64_t s = prefetched / batch_size;
+          const uint64_t count = std::min(batch_size, staged - prefetched);
+          // Like a partial batch, the unused lanes repeat the first key
+          for(uint_fast32_t j = count; j < batch_size; j++){
+            bucket_hashes[s][j] = bucket_hashes[s][0];
+            fingerprints[s][j] = fingerprints[s][0];
+          }
+          prefetch_lookup_blocks_many(bucket_hashes[s], fingerprints[s], 
+            _remap_enabled && !_morton_filter_functionality_enabled);
+          prefetched += count;
+          if(prefetched - compared > _lookup_prefetch_distance * batch_size){
+            compare_next();
+          }
+        }
+        while(drain && compared < staged){
+          compare_next();
+        }
+      }
+      if(_hot_key_cache_enabled){
+        _hot_key_cache_lookups += window_count;
+        _hot_key_cache_hits += cache_hits;
+      }
+      if(prefilter){
+        count_prefilter_lookups(window_count - cache_hits, 
+          window_count - cache_hits - staged);
+      }
+      for(uint64_t i = 0; i < window_count; i += batch_size){
+        ar_bitmap found;
+        extract_batch_bits(results, i, found);
+        output.write(w + i, found, std::min(batch_size, window_count - i));
+      }
+    }
+  }
+
+  inline void likely_contains_many(const std::vector<keys_t>& keys, 
+    std::vector<bool>& status, const uint64_t num_keys) const{
+    StatusVectorOutput output(status);
+    likely_contains_many_impl(keys.data(), num_keys, output);
+  }
+
+  template<class ContiguousIterator>
+  inline void likely_contains_many(ContiguousIterator first, 
+    ContiguousIterator last, std::vector<bool>& status) const{
+    StatusVectorOutput output(status);
+    if(first != last){
+      likely_contains_many_impl(contiguous_keys(first), last - first, output);
+    }
+  }
+
+  // Writes the result for key i to bit i % 64 of status_bitmap[i / 64] using
+  // whole-word stores.  status_bitmap needs (num_keys + 63) / 64 words.
+  inline void likely_contains_many(const std::vector<keys_t>& keys, 
+    uint64_t* status_bitmap, const uint64_t num_keys) const{
+    BitmapOutput output(status_bitmap);
+    likely_contains_many_impl(keys.data(), num_keys, output);
+  }
+
+  template<class ContiguousIterator>
+  inline void likely_contains_many(ContiguousIterator first, 
+    ContiguousIterator last, uint64_t* status_bitmap) const{
+    BitmapOutput output(status_bitmap);
+    if(first != last){
+      likely_contains_many_impl(contiguous_keys(first), last - first, output);
+    }
+  }
+
+  // Returns how many of the keys are likely contained without materializing 
+  // per-key results
+  inline uint64_t count_likely_contained_many(const std::vector<keys_t>& keys,
+    const uint64_t num_keys) const{
+    CountOutput output;
+    likely_contains_many_impl(keys.data(), num_keys, output);
+    return output._count;
+  }
+
+  template<class ContiguousIterator>
+  inline uint64_t count_likely_contained_many(ContiguousIterator first, 
+    ContiguousIterator last) const{
+    CountOutput output;
+    if(first != last){
+      likely_contains_many_impl(contiguous_keys(first), last - first, output);
+    }
+    return output._count;
+  }
+
+  // Columnar versions of the batch APIs, which read the keys in place from a
+  // KeyColumn (see key_column.h) instead of a dense std::vector<keys_t>.  
+  // Results and statuses line up with the column's rows, so status needs 
+  // room for column._num_rows entries and status_bitmap for 
+  // (column._num_rows + 63) / 64 words.  Null rows are never found, 
+  // inserted, or deleted, and their status is false.  A column of keys_t 
+  // with no padding between rows is probed where it is, and its null rows 
+  // are masked out of the results.  Other columns are gathered 
+  // _column_chunk_keys rows at a time into a buffer on the stack, so the 
+  // column is never materialized.  Insertions and deletions also compact 
+  // each chunk's valid rows in that buffer, since their batch kernels have 
+  // no way to skip a lane, and carry a partial batch of them over to the 
+  // next chunk.
+  inline void likely_contains_many(const KeyColumn& column, 
+    std::vector<bool>& status) const{
+    StatusVectorOutput output(status);
+    likely_contains_many_column_impl(column, output);
+  }
+
+  inline void likely_contains_many(const KeyColumn& column, 
+    uint64_t* status_bitmap) const{
+    BitmapOutput output(status_bitmap);
+    likely_contains_many_column_impl(column, output);
+  }
+
+  inline uint64_t count_likely_contained_many(const KeyColumn& column) const{
+    CountOutput output;
+    likely_contains_many_column_impl(column, output);
+    return output._count;
+  }
+
+  // Returns whether every valid row was stored
+  inline bool insert_many(const KeyColumn& column, std::vector<bool>& status){
+    bool all_stored = true;
+    column_many_impl(column, status, [this, &all_stored](const keys_t* keys, 
+      uint64_t num_keys, std::vector<bool>& chunk_status, uint64_t first_row){
+      all_stored &= insert_many_impl(keys, num_keys, chunk_status, first_row);
+    });
+    return all_stored;
+  }
+
+  inline void delete_many(const KeyColumn& column, std::vector<bool>& status){
+    column_many_impl(column, status, [this](const keys_t* keys, 
+      uint64_t num_keys, std::vector<bool>& chunk_status, uint64_t){
+      delete_many_impl(keys, num_keys, chunk_status);
+    });
+  }
+
+  inline void check_key_column(const KeyColumn& column) const{
+    if(column._width_bytes > sizeof(keys_t)){
+      std::cerr << "KeyColumn keys are " << column._width_bytes << " bytes "
+        "wide, but this filter's keys are only " << sizeof(keys_t) << "\n";
+      exit(1);
+    }
+  }
+
+  // Whether the column can be read as a keys_t array where it is
+  inline bool key_column_is_dense(const KeyColumn& column) const{
+    return column._width_bytes == sizeof(keys_t) && 
+      column._stride_bytes == sizeof(keys_t) && 
+      reinterpret_cast<uintptr_t>(column._base) % alignof(keys_t) == 0;
+  }
+
+  template<class OUTPUT>
+  NOINLINE void likely_contains_many_column_impl(const KeyColumn& column, 
+    OUTPUT& output) const{
+    check_key_column(column);
+    if(column._num_rows == 0){
+      return;
+    }
+    if(key_column_is_dense(column)){
+      ValidityMaskedOutput<OUTPUT> masked(output, column, 0);
+      likely_contains_many_impl(reinterpret_cast<const keys_t*>(
+        column._base), column._num_rows, masked);
+      return;
+    }
+    keys_t chunk[_column_chunk_keys];
+    for(uint64_t r = 0; r < column._num_rows; r += _column_chunk_keys){
+      const uint64_t count = std::min(_column_chunk_keys, 
+        column._num_rows - r);
+      column.gather(r, count, chunk);
+      ValidityMaskedOutput<OUTPUT> masked(output, column, r);
+      likely_contains_many_impl(chunk, count, masked);
+    }
+  }
+
+  // Runs many_impl(keys, num_keys, chunk_status, first_row) on the valid 
+  // rows of the column a chunk at a time and scatters the statuses back to 
+  // the rows.  A dense column without nulls is passed through whole.  Each 
+  // call gets a multiple of batch_size keys except for the last one, since 
+  // many_impl does the num_keys % batch_size keys at the end as a partial 
+  // batch.
+  // The valid rows past the last full batch of a chunk are moved to the 
+  // front of the buffer and go out with the next chunk's.
+  template<class MANY_IMPL>
+  NOINLINE void column_many_impl(const KeyColumn& column, 
+    std::vector<bool>& status, MANY_IMPL many_impl){
+    check_key_column(column);
+    if(column._num_rows == 0){
+      return;
+    }
+    if(key_column_is_dense(column) && !column.has_nulls()){
+      many_impl(reinterpret_cast<const keys_t*>(column._base), 
+        column._num_rows, status, 0);
+      return;
+    }
+    // Room for a chunk plus fewer than batch_size keys carried over
+    constexpr uint64_t capacity = _column_chunk_keys + batch_size;
+    keys_t chunk[capacity];
+    std::vector<uint64_t> rows(capacity);
+    std::vector<bool> chunk_status(capacity);
+    // Counts the valid rows passed to many_impl so far so that the hybrid 
+    // insertion methods see the same key indexes as they would with the 
+    // nulls filtered out.
+    uint64_t valid_rows = 0;
+    uint64_t carried = 0;
+    for(uint64_t r = 0; r < column._num_rows; r += _column_chunk_keys){
+      const uint64_t count = std::min(_column_chunk_keys, 
+        column._num_rows - r);
+      column.gather(r, count, chunk + carried);
+      // Branch-free compaction in place after the carried keys, which is 
+      // safe because the write position never passes the read position
+      uint64_t valid_count = carried;
+      for(uint64_t i = 0; i < count; i++){
+        chunk[valid_count] = chunk[carried + i];
+        rows[valid_count] = r + i;
+        valid_count += column.valid(r + i);
+        status[r + i] = false;
+      }
+      const bool last_chunk = r + count == column._num_rows;
+      const uint64_t ready = last_chunk ? valid_count : 
+        valid_count - valid_count % batch_size;
+      if(ready > 0){
+        many_impl(chunk, ready, chunk_status, valid_rows);
+      }
+      for(uint64_t j = 0; j < ready; j++){
+        status[rows[j]] = chunk_status[j];
+      }
+      valid_rows += ready;
+      carried = valid_count - ready;
+      std::copy(chunk + ready, chunk + valid_count, chunk);
+      std::copy(rows.begin() + ready, rows.begin() + valid_count, 
+        rows.begin());
+    }
+  }
+
+  // With random keys, every lookup of a big filter goes to a random block of 
+  // _storage, so most of them miss in both the caches and the TLB.  For 
+  // very large inputs (millions of keys), this version instead radix 
+  // partitions the keys by the high bits of their primary block ids, probes 
+  // one partition at a time so that the accesses stay within a contiguous, 
+  // cache-sized region of _storage, and scatters the results back into input
+  // order.  Secondary buckets are at most about 8K buckets away for 
+  // TABLE_BASED_OFFSET and FUNCTION_BASED_OFFSET, so secondary probes mostly
+  // stay in or next to the same region.  FAN_ET_AL_PARTIAL_KEY still works, 
+  // but its secondary probes don't get the locality.
+  //
+  // The keys are hashed twice (once to size the partitions and once to 
+  // scatter them), which is cheaper than writing and rereading the hashes.
+  // Each partitioned key is a bucket id and fingerprint packed into 64 bits 
+  // plus a 32-bit input index, so the scratch space is 12 bytes per key.  
+  // Falls back to likely_contains_many_impl when the filter is small, the 
+  // input is too small to revisit blocks, or the input has 2^32 or more keys.
+  template<class OUTPUT>
+  NOINLINE void likely_contains_many_partitioned_impl(const keys_t* keys, 
+    const uint64_t num_keys, OUTPUT& output) const{
+    constexpr uint64_t fingerprint_mask = _fingerprint_len_bits < 64 ? 
+      (1ULL << (_fingerprint_len_bits % 64)) - 1 : ~0ULL;
+    const uint64_t table_bytes = _total_blocks * sizeof(block_t);
+    uint_fast16_t radix_bits = 0;
+    while((table_bytes >> radix_bits) > _partitioned_lookup_region_bytes && 
+      radix_bits < _partitioned_lookup_max_radix_bits){
+      radix_bits++;
+    }
+    const uint64_t partitions = 1ULL << radix_bits;
+    const bool packable = _fingerprint_len_bits < 32 && 
+      (static_cast<uint64_t>(_total_buckets) >> 
+      (64 - _fingerprint_len_bits % 64)) == 0;
+    if(radix_bits == 0 || !packable || num_keys >> 32 || 
+      num_keys < _total_blocks ||
+      num_keys < partitions * _partitioned_lookup_min_keys_per_partition){
+      likely_contains_many_impl(keys, num_keys, output);
+      return;
+    }
+    // Block ids are less than 2^block_id_bits
+    const uint_fast16_t block_id_bits = 64 - __builtin_clzll(_total_blocks - 1);
+    const uint_fast16_t shift = block_id_bits > radix_bits ? 
+      block_id_bits - radix_bits : 0;
+
+    std::vector<uint64_t> partition_offsets(partitions + 1, 0);
+    std::vector<uint64_t> packed_probes(num_keys);
+    std::vector<uint32_t> probe_indexes(num_keys);
+    std::vector<uint64_t> results((num_keys + 63) / 64 + batch_bitmap_words, 
+      0);
+
+    // Histogram the primary block ids of the keys and then scatter them
+    ar_hash bucket_hashes;
+    ar_atom fingerprints;
+    for(uint_fast16_t pass = 0; pass < 2; pass++){
+      for(hash_t i = 0; i < num_keys; i += batch_size){
+        const uint64_t count = std::min(static_cast<uint64_t>(batch_size), 
+          num_keys - i);
+        if(count == batch_size){
+          hash_many(&keys[i], bucket_hashes, fingerprints);
+        }
+        else{
+          hash_many_partial(&keys[i], count, bucket_hashes, fingerprints);
+        }
+        if(pass == 0){
+          for(uint_fast32_t j = 0; j < count; j++){
+            partition_offsets[((bucket_hashes[j] / _buckets_per_block) >> 
+              shift) + 1]++;
+          }
+          continue;
+        }
+        for(uint_fast32_t j = 0; j < count; j++){
+          const uint64_t slot = partition_offsets[(bucket_hashes[j] / 
+            _buckets_per_block) >> shift]++;
+          packed_probes[slot] = (static_cast<uint64_t>(bucket_hashes[j]) << 
+            _fingerprint_len_bits) | fingerprints[j];
+          probe_indexes[slot] = i + j;
+        }
+      }
+      if(pass == 0){
+        std::partial_sum(partition_offsets.begin(), partition_offsets.end(), 
+          partition_offsets.begin());
+      }
+    }
+
+    // The scatter advanced each offset to the start of the next partition, so
+    // partition p is now [partition_offsets[p - 1], partition_offsets[p]).
+    // Batches are formed across partition boundaries since neighboring 
+    // partitions are neighboring regions anyway.  Like likely_contains_many, 
+    // the next batch's primary blocks are prefetched before the current 
+    // batch is compared, because the first touch of each block in a region 
+    // still misses.
+    auto unpack = [&](uint64_t i, ar_hash& b, ar_atom& f){
+      const uint64_t count = std::min(static_cast<uint64_t>(batch_size), 
+        num_keys - i);
+      for(uint_fast32_t j = 0; j < batch_size; j++){
+        const uint64_t packed = packed_probes[j < count ? i + j : i];
+        b[j] = packed >> _fingerprint_len_bits;
+        f[j] = packed & fingerprint_mask;
+      }
+    };
+    ar_hash next_bucket_hashes;
+    ar_atom next_fingerprints;
+    unpack(0, next_bucket_hashes, next_fingerprints);
+    for(hash_t i = 0; i < num_keys; i += batch_size){
+      bucket_hashes = next_bucket_hashes;
+      fingerprints = next_fingerprints;
+      if(i + batch_size < num_keys){
+        unpack(i + batch_size, next_bucket_hashes, next_fingerprints);
+        prefetch_blocks_many(next_bucket_hashes);
+      }
+      ar_bitmap found;
+      table_read_and_compare_many(bucket_hashes, fingerprints, found);
+      const uint64_t count = std::min(static_cast<uint64_t>(batch_size), 
+        num_keys - i);
+      for(uint_fast32_t j = 0; j < count; j++){
+        const uint32_t index = probe_indexes[i + j];
+        results[index / 64] |= static_cast<uint64_t>(
+          get_batch_bit(found, j)) << (index % 64);
+      }
+    }
+
+    for(hash_t i = 0; i < num_keys; i += batch_size){
+      ar_bitmap found;
+      extract_batch_bits(results.data(), i, found);
+      output.write(i, found, std::min(static_cast<uint64_t>(batch_size), 
+        num_keys - i));
+    }
+  }
+
+  inline void likely_contains_many_partitioned(const std::vector<keys_t>& keys,
+    std::vector<bool>& status, const uint64_t num_keys) const{
+    StatusVectorOutput output(status);
+    likely_contains_many_partitioned_impl(keys.data(), num_keys, output);
   }
 
-  inline bool insert_many(const std::vector<keys_t>& keys, 
-    std::vector<bool>& status, const uint64_t num_keys){
-    for(hash_t i = 0; i < num_keys; i += batch_size){
-      ar_hash bucket_hashes;
-      ar_atom fingerprints;
-      for(hash_t j = 0; j < batch_size; j++){
-        bucket_hashes[j] = raw_primary_hash(keys[i + j]);
+  template<class ContiguousIterator>
+  inline void likely_contains_many_partitioned(ContiguousIterator first, 
+    ContiguousIterator last, std::vector<bool>& status) const{
+    StatusVectorOutput output(status);
+    if(first != last){
+      likely_contains_many_partitioned_impl(contiguous_keys(first), 
+        last - first, output);
+    }
+  }
+
+  inline void likely_contains_many_partitioned(const std::vector<keys_t>& keys,
+    uint64_t* status_bitmap, const uint64_t num_keys) const{
+    BitmapOutput output(status_bitmap);
+    likely_contains_many_partitioned_impl(keys.data(), num_keys, output);
+  }
+
+  template<class ContiguousIterator>
+  inline void likely_contains_many_partitioned(ContiguousIterator first, 
+    ContiguousIterator last, uint64_t* status_bitmap) const{
+    BitmapOutput output(status_bitmap);
+    if(first != last){
+      likely_contains_many_partitioned_impl(contiguous_keys(first), 
+        last - first, output);
+    }
+  }
+
+  // Split-phase lookups.  prefetch_many hashes the keys and prefetches their
+  // primary blocks (and for compressed cuckoo filters, which always check 
+  // both buckets, their secondary blocks too).  resolve_many later does the 
+  // comparisons.  The caller can do other work in between (e.g., decode the 
+  // next chunk of a column) while the blocks are on their way.  Morton 
+  // filters don't know whether they need a key's secondary bucket until its 
+  // primary block's OTA has been read, so resolve_many prefetches those as 
+  // part of the regular batched secondary pass, unless the OTA summary is 
+  // enabled, in which case prefetch_many prefetches them up front.
+  //
+  // The prefetched blocks need to still be in the cache at resolve time, so
+  // a handle should cover somewhere between a few hundred and a few thousand
+  // keys.  The handle keeps its buffers between uses.  The filter must not be
+  // modified between the two phases.
+  class LookupHandle{
+    friend CompressedCuckooFilter;
+    std::vector<ar_hash> _bucket_hashes;
+    std::vector<ar_atom> _fingerprints;
+    uint64_t _num_keys = 0;
+  public:
+    inline uint64_t size() const{
+      return _num_keys;
+    }
+  };
+
+  inline void prefetch_many_impl(const keys_t* keys, const uint64_t num_keys, 
+    LookupHandle& handle) const{
+    const uint64_t batches = (num_keys + batch_size - 1) / batch_size;
+    handle._bucket_hashes.resize(batches);
+    handle._fingerprints.resize(batches);
+    handle._num_keys = num_keys;
+    for(uint64_t b = 0; b < batches; b++){
+      const uint64_t i = b * batch_size;
+      ar_hash& bucket_hashes = handle._bucket_hashes[b];
+      ar_atom& fingerprints = handle._fingerprints[b];
+      if(i + batch_size <= num_keys){
+        hash_many(&keys[i], bucket_hashes, fingerprints);
       }
-      for(hash_t j = 0; j < batch_size; j++){
-        // Now primary buckets
-        fingerprints[j] = fingerprint_function(bucket_hashes[j]);
-        bucket_hashes[j] = map_to_bucket(bucket_hashes[j], _total_buckets);
+      else{
+        hash_many_partial(&keys[i], num_keys - i, bucket_hashes, fingerprints);
       }
-      switch(_insertion_method){
-        case InsertionMethodEnum::TWO_CHOICE:
-          table_store_many_two_choice(bucket_hashes, fingerprints, status, i);
-          break;
-        case InsertionMethodEnum::FIRST_FIT:
-          table_store_many(bucket_hashes, fingerprints, status, i);
-          break;
-        // Differs from hybrid approach in only several lines of code
-        case InsertionMethodEnum::HYBRID_PIECEWISE:
-        case InsertionMethodEnum::FIRST_FIT_OPT:{
-          double cutoff_fraction = 0.7;//0.89;
-          hash_t cutoff_point = cutoff_fraction * _total_blocks * 
-            _max_fingerprints_per_block;
-          if(i < cutoff_point){
-            table_store_many(bucket_hashes, fingerprints, status, i);
-          }
-          else{
-            table_store_many_two_choice(bucket_hashes, fingerprints, status, i);
-          }
-          break;
-        }
-        case InsertionMethodEnum::HYBRID_SIMPLE:{
-          // Execute else for every 1 / cutoff_divisor batches
-          constexpr hash_t cutoff_divisor = 3;
-          if((i % (cutoff_divisor * batch_size)) != 0){
-            table_store_many(bucket_hashes, fingerprints, status, i);
-          }
-          else{
-            table_store_many_two_choice(bucket_hashes, fingerprints, status, i);
-          }
-          break;
-        }
-        default: // Put here to make the compiler happy
-          std::cerr << "SOMETHING IS WRONG IF YOU ARE HERE\n";
-          exit(1);
-          break;
+      prefetch_lookup_blocks_many(bucket_hashes, fingerprints, 
+        _remap_enabled && !_morton_filter_functionality_enabled);
+    }
+    // The summary entries had the rest of the loop to arrive
+    if(_morton_filter_functionality_enabled && ota_summary_enabled()){
+      for(uint64_t b = 0; b < batches; b++){
+        prefetch_flagged_alternate_blocks_many(handle._bucket_hashes[b], 
+          handle._fingerprints[b]);
       }
     }
-    return true; // FIXME: Check statuses
   }
 
-  // Item at a time
-  inline bool insert(const keys_t key){
-    hash_t raw_hash = raw_primary_hash(key);
-    
-    atom_t fingerprint = fingerprint_function(raw_hash);
-    // Primary bucket
-    hash_t primary_bucket = map_to_bucket(raw_hash, _total_buckets);
-    
-    if(_DEBUG){  // Replace with debug variable
-      std::cout << "Inserting key: " 
-        << key << " "
-        << "Fingerprint: " << fingerprint << " Bucket index: " 
-        << primary_bucket << std::endl;
-      fflush(stdout);
+  inline void prefetch_many(const std::vector<keys_t>& keys, 
+    const uint64_t num_keys, LookupHandle& handle) const{
+    prefetch_many_impl(keys.data(), num_keys, handle);
+  }
+
+  template<class ContiguousIterator>
+  inline void prefetch_many(ContiguousIterator first, ContiguousIterator last,
+    LookupHandle& handle) const{
+    if(first != last){
+      prefetch_many_impl(contiguous_keys(first), last - first, handle);
     }
-    
-    uint8_t* counters;
-    if(_DEBUG){
-      std::cout << "IN DEBUG" << std::endl;
-      counters = new uint8_t[_total_buckets];
-      for(uint64_t i = 0; i < _total_buckets; i++){
-        counters[i] = read_counter(i / _buckets_per_block, 
-          i % _buckets_per_block);
-      }
+    else{
+      handle._num_keys = 0;
     }
-    bool ret = table_store(primary_bucket, fingerprint);
-    if(_DEBUG){
-      for(uint64_t i = 0; i < _total_buckets; i++){
-        atom_t counter_read = read_counter(i / _buckets_per_block, i % _buckets_per_block);
-        if(counters[i] != counter_read && i != primary_bucket){
-          std::cerr << "table_store is corrupting counters.\n" << std::endl;
-          std::cerr << std::flush;
-          exit(1);
-        }
-        else if(i == primary_bucket && counters[i] + 1u != counter_read){
-          std::cerr << "table_store is not properly incrementing counters.\n" 
-            << std::endl;
-          std::cerr << std::flush;
-          exit(1);
-        }
-      }
-      delete[] counters;
+  }
+
+  template<class OUTPUT>
+  NOINLINE void resolve_many_impl(const LookupHandle& handle, OUTPUT& output) 
+    const{
+    for(uint64_t b = 0; b * batch_size < handle._num_keys; b++){
+      const uint64_t i = b * batch_size;
+      ar_bitmap found;
+      table_read_and_compare_many(handle._bucket_hashes[b], 
+        handle._fingerprints[b], found);
+      output.write(i, found, std::min(static_cast<uint64_t>(batch_size), 
+        handle._num_keys - i));
     }
-    return ret;
   }
- 
-  inline void likely_contains_many(const std::vector<keys_t>& keys, 
-    std::vector<bool>& status, const uint64_t num_keys) const{
-    for(hash_t i = 0; i < num_keys; i += batch_size){
-      ar_hash bucket_hashes;
-      ar_atom fingerprints;
-      for(hash_t j = 0; j < batch_size; j++){
-        bucket_hashes[j] = raw_primary_hash(keys[i + j]);
-      }
-      for(hash_t j = 0; j < batch_size; j++){
-        // Now primary buckets
-        fingerprints[j] = fingerprint_function(bucket_hashes[j]);
-        bucket_hashes[j] = map_to_bucket(bucket_hashes[j], 
-          _total_buckets);
-      }
-      // Write the output statuses directly to the output status vector "status"
-      table_read_and_compare_many(bucket_hashes, fingerprints, status, i); 
-    }  
+
+  // Writes the result for the i-th key passed to prefetch_many to status[i]
+  inline void resolve_many(const LookupHandle& handle, 
+    std::vector<bool>& status) const{
+    StatusVectorOutput output(status);
+    resolve_many_impl(handle, output);
+  }
+
+  // Bitmap version.  See likely_contains_many.
+  inline void resolve_many(const LookupHandle& handle, 
+    uint64_t* status_bitmap) const{
+    BitmapOutput output(status_bitmap);
+    resolve_many_impl(handle, output);
+  }
+
+  // Semi-join style lookups: writes the indexes of the keys that are likely 
+  // contained to selection and returns how many there are.  selection must 
+  // have room for num_keys entries because of the branch-free compaction 
+  // (see SelectionOutput in batch_output.h).  SEL_T has to be able to hold 
+  // num_keys - 1, e.g., a uint16_t selection vector takes at most 65536 
+  // keys per call.
+  template<class SEL_T>
+  inline uint64_t select_likely_contained_many(const std::vector<keys_t>& keys,
+    SEL_T* selection, const uint64_t num_keys) const{
+    check_selection_range<SEL_T>(num_keys);
+    SelectionOutput<SEL_T> output(selection);
+    likely_contains_many_impl(keys.data(), num_keys, output);
+    return output._count;
+  }
+
+  template<class ContiguousIterator, class SEL_T>
+  inline uint64_t select_likely_contained_many(ContiguousIterator first, 
+    ContiguousIterator last, SEL_T* selection) const{
+    check_selection_range<SEL_T>(last - first);
+    SelectionOutput<SEL_T> output(selection);
+    if(first != last){
+      likely_contains_many_impl(contiguous_keys(first), last - first, output);
+    }
+    return output._count;
+  }
+
+  // Same as above, but also gathers payload[i] into payload_out for every 
+  // selected index i.  payload_out must have room for num_keys entries.
+  template<class SEL_T, class PAYLOAD_T>
+  inline uint64_t select_likely_contained_many(const std::vector<keys_t>& keys,
+    SEL_T* selection, const PAYLOAD_T* payload, PAYLOAD_T* payload_out, 
+    const uint64_t num_keys) const{
+    check_selection_range<SEL_T>(num_keys);
+    SelectionGatherOutput<SEL_T, PAYLOAD_T> output(selection, payload, 
+      payload_out);
+    likely_contains_many_impl(keys.data(), num_keys, output);
+    return output._count;
+  }
+
+  template<class ContiguousIterator, class SEL_T, class PAYLOAD_T>
+  inline uint64_t select_likely_contained_many(ContiguousIterator first, 
+    ContiguousIterator last, SEL_T* selection, const PAYLOAD_T* payload, 
+    PAYLOAD_T* payload_out) const{
+    check_selection_range<SEL_T>(last - first);
+    SelectionGatherOutput<SEL_T, PAYLOAD_T> output(selection, payload, 
+      payload_out);
+    if(first != last){
+      likely_contains_many_impl(contiguous_keys(first), last - first, output);
+    }
+    return output._count;
+  }
+
+  // The selection outputs store indexes as SEL_T, so they'd wrap around 
+  // past its maximum
+  template<class SEL_T>
+  inline void check_selection_range(const uint64_t num_keys) const{
+    static_assert(std::is_integral<SEL_T>::value, "Selection vectors hold "
+      "integer indexes");
+    if(num_keys > 0 && num_keys - 1 > static_cast<uint64_t>(
+      std::numeric_limits<SEL_T>::max())){
+      std::cerr << "select_likely_contained_many got " << num_keys << 
+        " keys, but its selection vector's type can only index " << 
+        static_cast<uint64_t>(std::numeric_limits<SEL_T>::max()) + 1 << 
+        " of them\n";
+      exit(1);
+    }
   }
 
   inline bool table_delete_item(hash_t bucket_id, atom_t fingerprint){
@@ -1018,24 +3274,72 @@ namespace CompressedCuckoo{
 
   inline void delete_many(const std::vector<keys_t>& keys,
     std::vector<bool>& status, const uint64_t num_keys){
+    delete_many_impl(keys.data(), num_keys, status);
+  }
+
+  template<class ContiguousIterator>
+  inline void delete_many(ContiguousIterator first, ContiguousIterator last,
+    std::vector<bool>& status){
+    if(first != last){
+      delete_many_impl(contiguous_keys(first), last - first, status);
+    }
+  }
+
+  NOINLINE void delete_many_impl(const keys_t* keys, const uint64_t num_keys,
+    std::vector<bool>& status){
+    // Like insert_many_impl, the last batch may be a partial one
     for(hash_t i = 0; i < num_keys; i += batch_size){
+      const uint_fast32_t count = std::min<uint64_t>(batch_size, 
+        num_keys - i);
       ar_hash bucket_hashes;
       ar_atom fingerprints;
-      for(hash_t j = 0; j < batch_size; j++){
-        bucket_hashes[j] = raw_primary_hash(keys[i + j]);
-        fingerprints[j] = fingerprint_function(bucket_hashes[j]);
+      ar_hash raw_hashes;
+      hash_t* const raw_hashes_out = _hot_key_cache_enabled ? 
+        raw_hashes.data() : nullptr;
+      if(count == batch_size){
+        hash_many(&keys[i], bucket_hashes, fingerprints, raw_hashes_out);
+      }
+      else{
+        hash_many_partial(&keys[i], count, bucket_hashes, fingerprints, 
+          raw_hashes_out);
+      }
+      if(_hot_key_cache_enabled){
+        for(uint_fast32_t j = 0; j < count; j++){
+          hot_key_cache_invalidate(raw_hashes[j]);
+        }
+      }
+      table_delete_item_many(bucket_hashes, fingerprints, status, i, count);
+      if(stash_nonempty()){
+        // The stash has to be searched before anything is drained, or a
+        // stashed key could be moved into the table after its table
+        // deletion failed
+        for(uint_fast32_t j = 0; j < count; j++){
+          if(!status[i + j]){
+            status[i + j] = stash_delete(bucket_hashes[j], fingerprints[j]);
+          }
+        }
+        // Either block might be the one that has room now
+        for(uint_fast32_t j = 0; j < count; j++){
+          if(!status[i + j]){
+            continue;
+          }
+          drain_stash(bucket_hashes[j] / _buckets_per_block);
+          if(_remap_enabled){
+            drain_stash(determine_alternate_bucket(bucket_hashes[j], 
+              fingerprints[j]) / _buckets_per_block);
+          }
+        }
       }
-      for(hash_t j = 0; j < batch_size; j++){
-        // Now primary buckets
-        bucket_hashes[j] = map_to_bucket(bucket_hashes[j], 
-          _total_buckets);
+      for(uint_fast32_t j = 0; j < count; j++){
+        _prefilter_stale_deletions += status[i + j];
+        _item_count -= status[i + j];
       }
-      table_delete_item_many(bucket_hashes, fingerprints, status, i);
     }
   }
 
   inline void table_delete_item_many(const ar_hash& bucket_ids, const ar_atom& 
-    fingerprints, std::vector<bool>& status, const hash_t write_offset){
+    fingerprints, std::vector<bool>& status, const hash_t write_offset, 
+    const uint_fast32_t count = batch_size){
     ar_hash block_ids;
     ar_counter counter_indexes;
     if(_handle_conflicts){
@@ -1046,13 +3350,14 @@ namespace CompressedCuckoo{
       for(uint_fast32_t i = 0; i < batch_size; i++){
         block_ids[i] = bucket_ids[i] / _buckets_per_block;
         counter_indexes[i] = bucket_ids[i] % _buckets_per_block;
-        conflict_vector[i] = conflict_exists<num_buckets>(bf, block_ids[i]); 
+        conflict_vector[i] = i < count && 
+          conflict_exists<num_buckets>(bf, block_ids[i]);
       }
 
       // Fall back to one at a time processing if two updates would be 
       // applied to the same block in a batch
       if(conflict_vector.any()){
-        for(uint_fast64_t i = 0; i < batch_size; i++){
+        for(uint_fast64_t i = 0; i < count; i++){
           status[write_offset + i] = table_delete_item(bucket_ids[i], 
             fingerprints[i]);
           if(status[write_offset + i] == false){
@@ -1075,11 +3380,11 @@ namespace CompressedCuckoo{
     ar_counter full_slots;
     read_counter_many(block_ids, counter_indexes, full_slots);
 
-    ar_counter i_with_secondary_lookup;
-    counter_t secondary_count = 0;
+    ar_u16 i_with_secondary_lookup;
+    uint_fast16_t secondary_count = 0;
  
     ar_counter bucket_start_indexes;
-    for(uint_fast64_t i = 0; i < batch_size; i++){
+    for(uint_fast64_t i = 0; i < count; i++){
       bucket_start_indexes[i] = get_bucket_start_index(block_ids[i], 
         counter_indexes[i]);
       uint8_t discovery_slot = return_slot_id_on_match<>(block_ids[i],
@@ -1116,10 +3421,13 @@ namespace CompressedCuckoo{
   // Item at a time
   inline bool delete_item(const keys_t key){
     hash_t raw_hash = raw_primary_hash(key);
+    hot_key_cache_invalidate(raw_hash);
     atom_t fingerprint = fingerprint_function(raw_hash);
     // Primary bucket
     hash_t primary_bucket = map_to_bucket(raw_hash, _total_buckets);
     bool return_status = false;
+    // The bucket that the item was deleted from
+    hash_t freed_bucket = primary_bucket;
     if(!_remap_enabled){
       return_status = table_delete_item(primary_bucket, fingerprint);
     }
@@ -1130,20 +3438,58 @@ namespace CompressedCuckoo{
         hash_t secondary_bucket = determine_alternate_bucket(primary_bucket,
           fingerprint);
         return_status = table_delete_item(secondary_bucket, fingerprint);
+        freed_bucket = secondary_bucket;
         // TODO: Try to clear the bit that the overflown item had set
         //attempt_to_clear_ota_bit(primary_bucket, secondary_bucket, fingerprint);
       }
     }
+    if(stash_nonempty()){
+      if(return_status){
+        drain_stash(freed_bucket / _buckets_per_block);
+      }
+      else{
+        return_status = stash_delete(primary_bucket, fingerprint);
+      }
+    }
+    _prefilter_stale_deletions += return_status;
+    _item_count -= return_status;
     return return_status;
   }
 
   // Item at a time
-  inline bool likely_contains(const keys_t key){
-    hash_t raw_hash = raw_primary_hash(key);
+  inline bool likely_contains(const keys_t key) const{
+    const hash_t raw_hash = raw_primary_hash(key);
+    if(_hot_key_cache_enabled){
+      _hot_key_cache_lookups++;
+      bool result;
+      if(hot_key_cache_lookup(raw_hash, result)){
+        _hot_key_cache_hits++;
+        return result;
+      }
+      result = likely_contains_hashed(raw_hash);
+      hot_key_cache_store(raw_hash, result);
+      return result;
+    }
+    return likely_contains_hashed(raw_hash);
+  }
+
+  inline bool likely_contains_hashed(const hash_t raw_hash) const{
     atom_t fingerprint = fingerprint_function(raw_hash);
     // Primary bucket
     hash_t primary_bucket = map_to_bucket(raw_hash, _total_buckets);
 
+    if(prefilter_enabled()){
+      const bool rejected = !prefilter_contains(primary_bucket, fingerprint);
+      count_prefilter_lookups(1, rejected);
+      if(rejected){
+        return false;
+      }
+    }
+
+    if(stash_contains(primary_bucket, fingerprint)){
+      return true;
+    }
+
     // Idealized implementation with no remapping necessary
     if(!_remap_enabled){
       return table_read_and_compare(primary_bucket, fingerprint); 
@@ -1227,52 +3573,204 @@ namespace CompressedCuckoo{
     return static_cast<double>(set_bit_count) / (_total_blocks * _ota_len_bits);
   }
 
+  // Morton filter lookups make two passes over the batch.  The first pass only
+  // touches primary blocks.  Keys that miss in their primary bucket and whose 
+  // OTA bit is set are queued up, and the second pass computes their alternate
+  // buckets, prefetches all of the secondary blocks, and only then reads them.
+  // Probing the secondary bucket inline puts a dependent cache miss right 
+  // behind the primary one for every such key, whereas deferring the probes 
+  // lets all of the batch's secondary misses be in flight at the same time.
   void test_fingerprint_in_bucket_many_morton(const ar_hash& bucket_ids, 
     const ar_hash& block_ids, 
     const ar_counter& bucket_start_indexes, const ar_counter& full_slots,
-    const ar_atom& fingerprints, std::vector<bool>& status, 
-    const hash_t write_offset) const{
+    const ar_atom& fingerprints, ar_bitmap& found) const{
+    ar_u16 i_with_secondary_lookup;
+    uint_fast16_t secondary_count = 0;
+    found.fill(0);
     for(uint_fast32_t i = 0; i < batch_size; i++){
       bool found_finger = test_fingerprint_in_bucket<>(block_ids[i], 
         bucket_start_indexes[i], 
         full_slots[i], fingerprints[i]);
+      set_batch_bit(found, i, found_finger);
 
-      uint_fast8_t secondary_lookup_necessary = (!found_finger) & 
+      // Branchless append to the list of keys that need a secondary lookup
+      i_with_secondary_lookup[secondary_count] = i;
+      secondary_count += (!found_finger) & 
         get_overflow_status(bucket_ids[i], fingerprints[i]); 
-      if(secondary_lookup_necessary){
-         hash_t secondary_bucket_id = determine_alternate_bucket(
-          bucket_ids[i], 
-          fingerprints[i]);
-        hash_t block_id = secondary_bucket_id / _buckets_per_block;
-        uint16_t counter_index = secondary_bucket_id % _buckets_per_block;
-        uint16_t bucket_start_index = get_bucket_start_index(block_id, 
-          counter_index);
-        counter_t secondary_full_slots = read_counter(block_id, counter_index);
+    }
+    probe_secondary_buckets_many(bucket_ids, fingerprints, 
+      i_with_secondary_lookup, secondary_count, found);
+  }
+
+  // The second pass of the Morton filter lookups.  Probes the alternate 
+  // buckets of the secondary_count keys listed in i_with_secondary_lookup and 
+  // sets their bits in found on a match.
+  INLINE void probe_secondary_buckets_many(const ar_hash& bucket_ids, 
+    const ar_atom& fingerprints, const ar_u16& i_with_secondary_lookup, 
+    uint_fast16_t secondary_count, ar_bitmap& found) const{
+    ar_hash secondary_block_ids;
+    ar_u16 secondary_counter_indexes;
+    for(uint_fast16_t j = 0; j < secondary_count; j++){
+      const uint_fast16_t i = i_with_secondary_lookup[j];
+      hash_t secondary_bucket_id = determine_alternate_bucket(bucket_ids[i], 
+        fingerprints[i]);
+      secondary_block_ids[j] = secondary_bucket_id / _buckets_per_block;
+      secondary_counter_indexes[j] = secondary_bucket_id % _buckets_per_block;
+      prefetch_block(secondary_block_ids[j]);
+    }
+
+    for(uint_fast16_t j = 0; j < secondary_count; j++){
+      const uint_fast16_t i = i_with_secondary_lookup[j];
+      counter_t bucket_start_index = get_bucket_start_index(
+        secondary_block_ids[j], secondary_counter_indexes[j]);
+      counter_t secondary_full_slots = read_counter(secondary_block_ids[j], 
+        secondary_counter_indexes[j]);
+      // Key i missed in its primary bucket, so its bit is still clear
+      set_batch_bit(found, i, test_fingerprint_in_bucket<>(
+        secondary_block_ids[j], bucket_start_index, secondary_full_slots, 
+        fingerprints[i]));
+    }
+  }
+
+  // The gather-based kernel works on the raw bytes of the block, so it needs 
+  // 64-byte blocks with the FCA at bit 0 and small enough to reduce with 
+  // popcounts, and a bucket's fingerprints need to fit in a single unaligned 
+  // 64-bit word (7 bits of slack for the start bit within the first byte).
+  constexpr static bool _gather_probe_supported = _remap_enabled && 
+    _morton_filter_functionality_enabled && 
+    (_reduction_method == ReductionMethodEnum::POP_CNT) && 
+    (sizeof(block_t) == simd_line_size_bytes) && 
+    (_fullness_counters_offset == 0) && 
+    (_fullness_counter_width * _buckets_per_block <= 128) && 
+    (_slots_per_bucket * _fingerprint_len_bits <= 57) && 
+    (batch_size % v8_lanes == 0);
+
+  // Configurations that chose SIMD_MASK keep the scalar first pass.  Its 
+  // whole-block compare already handles larger buckets well (Morton7_8 ran 
+  // at about 92 Mops with it vs. 75 Mops gathering), whereas Morton3_8 with 
+  // VARIABLE_COUNT went from about 62 to 104 Mops with gathers.
+  constexpr static bool _gather_probe_enabled = _gather_probe_supported && 
+    (_fingerprint_comparison_method != 
+    FingerprintComparisonMethodEnum::SIMD_MASK);
+
+  // Inter-key version of the first pass of test_fingerprint_in_bucket_many_
+  // morton that probes the primary buckets of v8_lanes keys per step.  Rather 
+  // than probing one key at a time and leaving it to the out-of-order core 
+  // to overlap the blocks' loads, every load is a gather of one word from each
+  // of the 8 blocks.  The 8 FCAs are gathered and the bucket start indexes 
+  // and counters are computed in-register as in exclusive_reduce_with_
+  // popcount_simd, then each bucket's fingerprints are gathered with a single 
+  // unaligned load starting at the byte holding the bucket's first 
+  // fingerprint, and every slot is compared at once across the 8 lanes.  The 
+  // OTA checks and the secondary pass are the same as in the scalar path.
+  void gather_probe_many_morton(const ar_hash& bucket_ids, 
+    const ar_atom& fingerprints, ar_bitmap& found) const{
+    constexpr uint64_t fca_bits = _fullness_counter_width * _buckets_per_block;
+    constexpr bool two_words = fca_bits > 64;
+    constexpr __uint128_t one = 1;
+    constexpr __uint128_t fca_mask = fca_bits == 128 ? ~static_cast<
+      __uint128_t>(0) : (one << fca_bits) - one;
+    constexpr uint64_t fca_mask_lo = static_cast<uint64_t>(fca_mask);
+    constexpr uint64_t fca_mask_hi = static_cast<uint64_t>(fca_mask >> 64);
+    constexpr uint64_t width = _fullness_counter_width;
+    constexpr uint64_t counter_mask = (1ULL << width) - 1;
+    constexpr uint64_t fingerprint_mask = _fingerprint_len_bits == 64 ? 
+      ~0ULL : (1ULL << _fingerprint_len_bits) - 1;
+    // Keeps the fingerprint word inside of the block
+    constexpr uint64_t max_fsa_byte = simd_line_size_bytes - sizeof(uint64_t);
+
+    uint64_t popcount_masks_lo[max_fullness_counter_width];
+    uint64_t popcount_masks_hi[max_fullness_counter_width];
+    for(uint64_t j = 0; j < width; j++){
+      const __uint128_t m = _popcount_masks128[0] << j;
+      popcount_masks_lo[j] = static_cast<uint64_t>(m);
+      popcount_masks_hi[j] = static_cast<uint64_t>(m >> 64);
+    }
+
+    ar_u16 i_with_secondary_lookup;
+    uint_fast16_t secondary_count = 0;
+    found.fill(0);
+    for(uint_fast32_t i = 0; i < batch_size; i += v8_lanes){
+      v8_u64 block_offsets, shifts, fps;
+      for(uint64_t l = 0; l < v8_lanes; l++){
+        block_offsets[l] = (bucket_ids[i + l] / _buckets_per_block) * 
+          simd_line_size_bytes;
+        shifts[l] = width * (bucket_ids[i + l] % _buckets_per_block);
+        fps[l] = fingerprints[i + l];
+      }
+      v8_u64 lo = gather8_u64(_storage, block_offsets) & fca_mask_lo;
+      v8_u64 hi = {};
+      if(two_words){
+        hi = gather8_u64(_storage, block_offsets + sizeof(uint64_t)) & 
+          fca_mask_hi;
+      }
 
-        found_finger = test_fingerprint_in_bucket<>(
-          block_id, 
-          bucket_start_index, 
-          secondary_full_slots, fingerprints[i]);
+      // Exclusive reduction of the counters before the bucket's
+      const v8_u64 lo_shifts = shifts < 64 ? shifts : 64;
+      const v8_u64 hi_shifts = shifts < 64 ? 0 : shifts - 64;
+      const v8_u64 prefix_lo = lo & low_bits_mask8(lo_shifts);
+      const v8_u64 prefix_hi = hi & low_bits_mask8(hi_shifts);
+      v8_u64 starts = {};
+      for(uint64_t j = 0; j < width; j++){
+        starts += popcount8(prefix_lo & popcount_masks_lo[j]) << j;
+        if(two_words){
+          starts += popcount8(prefix_hi & popcount_masks_hi[j]) << j;
+        }
+      }
+
+      // The bucket's counter, which may straddle the two FCA words
+      v8_u64 full = lo >> (lo_shifts & 63);
+      if(two_words){
+        // hi << (64 - shift) split in two so that a shift of 0 is defined
+        full = shifts < 64 ? full | ((hi << 1) << (63 - lo_shifts)) : 
+          hi >> hi_shifts;
+      }
+      full &= counter_mask;
+
+      // Gather the word holding the bucket's fingerprints
+      const v8_u64 fsa_bits = _fingerprint_offset + 
+        starts * _fingerprint_len_bits;
+      const v8_u64 fsa_bytes = (fsa_bits >> 3) < max_fsa_byte ? 
+        (fsa_bits >> 3) : max_fsa_byte;
+      const v8_u64 fsa_word = gather8_u64(_storage, block_offsets + fsa_bytes);
+      const v8_u64 fsa_shifts = fsa_bits - (fsa_bytes << 3);
+
+      v8_u64 hits = {};
+      for(uint64_t k = 0; k < _slots_per_bucket; k++){
+        // Slots past the counter may lie past the end of the block, so clamp
+        // their shift.  They are masked off anyway.
+        const v8_u64 slot_shifts = fsa_shifts + k * _fingerprint_len_bits;
+        const v8_u64 slot = (fsa_word >> (slot_shifts < 63 ? slot_shifts : 
+          63)) & fingerprint_mask;
+        hits |= reinterpret_cast<v8_u64>((slot == fps) & (k < full));
+      }
+
+      for(uint64_t l = 0; l < v8_lanes; l++){
+        const bool found_finger = hits[l] != 0;
+        set_batch_bit(found, i + l, found_finger);
+        i_with_secondary_lookup[secondary_count] = i + l;
+        secondary_count += (!found_finger) & 
+          get_overflow_status(bucket_ids[i + l], fingerprints[i + l]);
       }
-      status[write_offset + i] = found_finger;  
     }
+    probe_secondary_buckets_many(bucket_ids, fingerprints, 
+      i_with_secondary_lookup, secondary_count, found);
   }
 
   inline void test_fingerprint_in_bucket_many(const ar_hash& block_ids, 
     const ar_counter& bucket_start_indexes, const ar_counter& full_slots,
-    const ar_atom& fingerprints, std::vector<bool>& status, 
-    const hash_t write_offset) const{
+    const ar_atom& fingerprints, ar_bitmap& found) const{
     if(_DEBUG){
       util::print_array<ar_hash>("block_ids: ", block_ids);
       util::print_array<ar_counter>("bucket_start_indexes: ", 
         bucket_start_indexes);
       util::print_array<ar_counter>("full_slots: ", full_slots);
       util::print_array<ar_atom>("fingerprints: ", fingerprints);
-      std::cout << "Write Offset: " << write_offset << std::endl;
     }
+    found.fill(0);
     for(uint_fast32_t i = 0; i < batch_size; i++){
-      status[write_offset + i] = test_fingerprint_in_bucket<>(block_ids[i], 
-        bucket_start_indexes[i], full_slots[i], fingerprints[i]);
+      set_batch_bit(found, i, test_fingerprint_in_bucket<>(block_ids[i], 
+        bucket_start_indexes[i], full_slots[i], fingerprints[i]));
     }
   }
 
@@ -1341,12 +3839,58 @@ namespace CompressedCuckoo{
         } 
       }      
     }
+
+    // Compare every slot of the bucket in a handful of instructions rather 
+    // than with one read_fingerprint per slot
+    else if (t_comparison_method == FingerprintComparisonMethodEnum::SIMD_MASK) {
+      if(_simd_comparison_supported){
+        match_index = simd_slot_id_on_match(block_id, bucket_start_index, 
+          full_slots, fingerprint);
+      }
+      else{
+        match_index = return_slot_id_on_match<
+          FingerprintComparisonMethodEnum::VARIABLE_COUNT>(block_id, 
+          bucket_start_index, full_slots, fingerprint);
+      }
+    }
     return match_index;
   }
 
+  // The SIMD kernels compare the query fingerprint against every fingerprint-
+  // sized lane of the 512-bit block, so the FSA must begin on a lane boundary.
+  constexpr static bool _simd_comparison_supported = 
+    (sizeof(block_t) == simd_line_size_bytes) && (
+    (_fingerprint_len_bits == 8 && _fingerprint_offset % 8 == 0) ||
+    (_fingerprint_len_bits == 16 && _fingerprint_offset % 16 == 0));
+
+  // Broadcasts the fingerprint, compares it against the whole block, and then
+  // shifts the bucket's window of the FSA down to bit 0 of the match mask.  
+  // Lanes beyond full_slots belong to other buckets or are empty, so they are 
+  // masked off.  Like VARIABLE_COUNT, it returns the last matching slot.
+  INLINE hash_t simd_slot_id_on_match(hash_t block_id, 
+    counter_t bucket_start_index, uint8_t full_slots, atom_t fingerprint) const{
+    constexpr uint64_t lanes = (simd_line_size_bytes * 8) / 
+      _fingerprint_len_bits;
+    constexpr uint64_t fsa_first_lane = _fingerprint_offset / 
+      _fingerprint_len_bits;
+    const uint64_t valid_lanes = (static_cast<uint64_t>(1) << full_slots) - 1;
+    // An empty bucket may start one past the last lane, so mask the shift
+    const uint64_t shift = (fsa_first_lane + bucket_start_index) & (lanes - 1);
+    uint64_t matches;
+    if(_fingerprint_len_bits == 8){
+      matches = match_bytes64(&_storage[block_id], 
+        static_cast<uint8_t>(fingerprint));
+    }
+    else{
+      matches = match_words64(&_storage[block_id], 
+        static_cast<uint16_t>(fingerprint));
+    }
+    matches = (matches >> shift) & valid_lanes;
+    return matches ? 63 - __builtin_clzll(matches) : _slots_per_bucket;
+  }
+
   inline void table_read_and_compare_many_pessimistic(const ar_hash& bucket_ids,
-    const ar_atom& fingerprints, std::vector<bool>& status,
-    const hash_t write_offset) const{
+    const ar_atom& fingerprints, ar_bitmap& found) const{
     ar_hash block_ids[2];
     ar_hash alternate_bucket_ids;
     ar_counter counter_indexes[2];
@@ -1363,13 +3907,12 @@ namespace CompressedCuckoo{
     read_counter_many(block_ids[1], counter_indexes[1], full_slots[1]);
     
     ar_counter bucket_start_indexes[2];
-    for(uint_fast32_t i = 0; i < batch_size; i++){
-      bucket_start_indexes[0][i] = get_bucket_start_index(block_ids[0][i], 
-        counter_indexes[0][i]);
-      bucket_start_indexes[1][i] = get_bucket_start_index(block_ids[1][i], 
-        counter_indexes[1][i]);
-    }
+    bucket_start_indexes[0] = exclusive_reduce_many<batch_size>(block_ids[0], 
+      counter_indexes[0]);
+    bucket_start_indexes[1] = exclusive_reduce_many<batch_size>(block_ids[1], 
+      counter_indexes[1]);
 
+    found.fill(0);
     for(uint_fast32_t i = 0; i < batch_size; i++){
       std::bitset<_slots_per_bucket> found1;
       std::bitset<_slots_per_bucket> found2;
@@ -1381,13 +3924,18 @@ namespace CompressedCuckoo{
         found2[j] = (fingerprints[i] == read_fingerprint(block_ids[1][i], 
           bucket_start_indexes[1][i] + j));
       }
-      status[write_offset + i] = found1.any() | found2.any();
+      set_batch_bit(found, i, found1.any() | found2.any());
     }
   }
 
-  inline void table_read_and_compare_many(const ar_hash& bucket_ids, 
-    const ar_atom& fingerprints, std::vector<bool>& status, 
-    const hash_t write_offset) const{
+  // Sets bit i of found iff the fingerprint of key i is in one of its buckets
+  INLINE void table_read_and_compare_many(const ar_hash& bucket_ids, 
+    const ar_atom& fingerprints, ar_bitmap& found) const{
+    if(_gather_probe_enabled){
+      gather_probe_many_morton(bucket_ids, fingerprints, found);
+      stash_read_and_compare_many(bucket_ids, fingerprints, found);
+      return;
+    }
     ar_hash block_ids;
     ar_counter counter_indexes;
     for(uint_fast32_t i = 0; i < batch_size; i++){
@@ -1397,23 +3945,20 @@ namespace CompressedCuckoo{
     ar_counter full_slots;
     read_counter_many(block_ids, counter_indexes, full_slots);
     
-    ar_counter bucket_start_indexes;
-    for(uint_fast32_t i = 0; i < batch_size; i++){
-      bucket_start_indexes[i] = get_bucket_start_index(block_ids[i], 
-        counter_indexes[i]);
-    }
+    ar_counter bucket_start_indexes = exclusive_reduce_many<batch_size>(
+      block_ids, counter_indexes);
 
     // Idealized implementation with no remapping necessary
     if(!_remap_enabled){
       test_fingerprint_in_bucket_many(block_ids, bucket_start_indexes, 
-        full_slots, fingerprints, status, write_offset);
+        full_slots, fingerprints, found);
     }
 
     // Compressed cuckoo filter implementation
     else if(!_morton_filter_functionality_enabled){
       // Check first bucket
       test_fingerprint_in_bucket_many(block_ids, bucket_start_indexes, 
-        full_slots, fingerprints, status, write_offset);
+        full_slots, fingerprints, found);
 
       ar_hash secondary_bucket_ids;
       ar_hash secondary_block_ids;
@@ -1433,18 +3978,22 @@ namespace CompressedCuckoo{
       read_counter_many(secondary_block_ids, secondary_counter_indexes, 
         secondary_full_slots);
 
-      // Check second bucket
+      // Check second bucket.  A key is present if it is in either bucket.
+      ar_bitmap found_secondary;
       test_fingerprint_in_bucket_many(secondary_block_ids, 
         secondary_bucket_start_indexes,
-        secondary_full_slots, fingerprints, status, write_offset);
+        secondary_full_slots, fingerprints, found_secondary);
+      for(uint_fast32_t w = 0; w < batch_bitmap_words; w++){
+        found[w] |= found_secondary[w];
+      }
     }
 
     // Morton Filter
     else{
       test_fingerprint_in_bucket_many_morton(bucket_ids, block_ids, 
-        bucket_start_indexes, full_slots, fingerprints, status, write_offset);
+        bucket_start_indexes, full_slots, fingerprints, found);
     }
-
+    stash_read_and_compare_many(bucket_ids, fingerprints, found);
   }
 
   // Global slot ID is the global index of the first slot of the bucket we're 
@@ -1591,36 +4140,40 @@ namespace CompressedCuckoo{
     return counter;
   }
 
-  inline void two_choice_store_many(const ar_hash& bucket_ids_1, 
+  NOINLINE void two_choice_store_many(const ar_hash& bucket_ids_1, 
     const ar_hash& bucket_ids_2, const ar_atom& fingerprints, 
     const ar_hash& block_ids_1, const ar_hash& block_ids_2,
-    std::vector<bool>& statuses, const hash_t offset){
-    ar_hash elements_in_blocks_1, elements_in_blocks_2;
+    std::vector<bool>& statuses, const hash_t offset, 
+    const bool first_fit_opt, const uint_fast32_t count){
+    ar_counter counter_indexes_1, counter_indexes_2;
     for(uint32_t i = 0; i < batch_size; i++){
-      elements_in_blocks_1[i] = exclusive_reduce(
-        _storage[block_ids_1[i]], _buckets_per_block);
-      elements_in_blocks_2[i] = exclusive_reduce(
-        _storage[block_ids_2[i]], _buckets_per_block);
+      counter_indexes_1[i] = bucket_ids_1[i] % _buckets_per_block;
+      counter_indexes_2[i] = bucket_ids_2[i] % _buckets_per_block;
     }
+    ar_counter elements_in_blocks_1, elements_in_blocks_2;
+    ar_counter bucket_start_indexes_1, bucket_start_indexes_2;
+    exclusive_reduce_and_load_many<batch_size>(block_ids_1, counter_indexes_1,
+      bucket_start_indexes_1, elements_in_blocks_1);
+    exclusive_reduce_and_load_many<batch_size>(block_ids_2, counter_indexes_2,
+      bucket_start_indexes_2, elements_in_blocks_2);
     std::bitset<batch_size> try_first_block_insert;
     for(uint32_t i = 0; i < batch_size; i++){
-      switch(_insertion_method){
-        case InsertionMethodEnum::FIRST_FIT_OPT:
-          try_first_block_insert[i] = (elements_in_blocks_1[i] != 
-            _max_fingerprints_per_block) | (elements_in_blocks_2[i] == 
-            _max_fingerprints_per_block);
-          break;
-        default: // HYBRID_PIECEWISE, TWO_CHOICE
-          try_first_block_insert[i] = (elements_in_blocks_1[i] <= 
-            elements_in_blocks_2[i]);
-          break;
-      } 
+      if(first_fit_opt){
+        try_first_block_insert[i] = (elements_in_blocks_1[i] != 
+          _max_fingerprints_per_block) | (elements_in_blocks_2[i] == 
+          _max_fingerprints_per_block);
+      }
+      else{ // HYBRID_PIECEWISE, TWO_CHOICE
+        try_first_block_insert[i] = (elements_in_blocks_1[i] <= 
+          elements_in_blocks_2[i]);
+      }
     }
     // Perfom a blend
     ar_hash bucket_ids;
     ar_hash block_ids;
     ar_counter counter_indexes;
     ar_counter elements_in_blocks;
+    ar_counter bucket_start_indexes;
     for(uint32_t i = 0; i < batch_size; i++){
       bucket_ids[i] = (try_first_block_insert[i] ? 
         bucket_ids_1[i] : bucket_ids_2[i]);
@@ -1628,16 +4181,14 @@ namespace CompressedCuckoo{
         block_ids_1[i] : block_ids_2[i]);
       elements_in_blocks[i] = (try_first_block_insert[i] ?
         elements_in_blocks_1[i] : elements_in_blocks_2[i]);
-    }
-    for(uint32_t i = 0; i < batch_size; i++){
-      counter_indexes[i] = bucket_ids[i] % _buckets_per_block;
+      counter_indexes[i] = (try_first_block_insert[i] ?
+        counter_indexes_1[i] : counter_indexes_2[i]);
+      bucket_start_indexes[i] = (try_first_block_insert[i] ?
+        bucket_start_indexes_1[i] : bucket_start_indexes_2[i]);
     }
 
-    ar_counter bucket_start_indexes =
-      exclusive_reduce_many<batch_size>(block_ids, counter_indexes);
-
     ar_counter counter_values;
-    for(uint32_t i = 0; i < batch_size; i++){
+    for(uint32_t i = 0; i < count; i++){
       counter_values[i] = read_counter(block_ids[i], 
         counter_indexes[i]);
       statuses[offset + i] = !((elements_in_blocks[i] == _max_fingerprints_per_block) || 
@@ -1656,7 +4207,7 @@ namespace CompressedCuckoo{
       }
     }
     // Set OTA if you placed the item in the secondary bucket/block
-    for(uint32_t i = 0; i < batch_size; i++){
+    for(uint32_t i = 0; i < count; i++){
       if(_morton_filter_functionality_enabled && (statuses[offset + i]) && 
         (!try_first_block_insert[i])){
         set_overflow_status(bucket_ids_1[i], fingerprints[i], 
@@ -1664,10 +4215,16 @@ namespace CompressedCuckoo{
       }
     }
     // Resolve lingering collisions
-    for(uint32_t i = 0; i < batch_size; i++){
+    for(uint32_t i = 0; i < count; i++){
       if(!statuses[offset + i]){
-        statuses[offset + i] = random_kickout_cuckoo(bucket_ids_1[i], 
-          fingerprints[i]); 
+        const InsertStatus status = make_room_and_store(bucket_ids_1[i], 
+          bucket_ids_2[i], fingerprints[i]);
+        statuses[offset + i] = status != InsertStatus::FAILED_TO_INSERT;
+        if(_morton_filter_functionality_enabled && 
+          status == InsertStatus::PLACED_IN_SECONDARY_BUCKET){
+          set_overflow_status(bucket_ids_1[i], fingerprints[i], 
+            block_ids_1[i], counter_indexes_1[i]);
+        }
       }
     }
   }
@@ -1693,19 +4250,26 @@ namespace CompressedCuckoo{
     const ar_atom& fingerprints, const ar_hash& block_ids, 
     ar_counter& counter_indexes,
     ar_counter& bucket_start_indexes, ar_counter& elements_in_blocks, 
-    ar_counter& counter_values, std::vector<bool>& statuses, const hash_t offset){
+    ar_counter& counter_values, std::vector<bool>& statuses, 
+    const hash_t offset, const uint_fast32_t count){
 
     for(uint32_t i = 0; i < batch_size; i++){
       counter_indexes[i] = bucket_ids[i] % _buckets_per_block;
     }
     
-    for(uint32_t i = 0; i < batch_size; i++){
-      elements_in_blocks[i] = report_fsa_load(block_ids[i]);
+    if(_special_null_fingerprint){
+      for(uint32_t i = 0; i < batch_size; i++){
+        elements_in_blocks[i] = report_fsa_load(block_ids[i]);
+      }
+      bucket_start_indexes =
+        exclusive_reduce_many<batch_size>(block_ids, counter_indexes);
+    }
+    else{
+      exclusive_reduce_and_load_many<batch_size>(block_ids, counter_indexes, 
+        bucket_start_indexes, elements_in_blocks);
     }
-    bucket_start_indexes =
-      exclusive_reduce_many<batch_size>(block_ids, counter_indexes);
 
-    for(uint32_t i = 0; i < batch_size; i++){
+    for(uint32_t i = 0; i < count; i++){
       counter_values[i] = read_counter(block_ids[i], counter_indexes[i]);
       statuses[offset + i] = !((elements_in_blocks[i] == 
         _max_fingerprints_per_block) | (counter_values[i] == _slots_per_bucket));
@@ -1730,9 +4294,13 @@ namespace CompressedCuckoo{
     return bf.contains_and_update(block_id);
   }
 
-  inline void table_store_many_two_choice(const ar_hash& bucket_ids_1,
+  // With first_fit_opt, each item goes to its first block unless that block
+  // is full and the second isn't (FIRST_FIT_OPT's second stage).  Otherwise,
+  // it goes to the emptier block.
+  NOINLINE void table_store_many_two_choice(const ar_hash& bucket_ids_1,
     const ar_atom& fingerprints, std::vector<bool>& statuses,
-    const hash_t offset){
+    const hash_t offset, const bool first_fit_opt, 
+    const uint_fast32_t count = batch_size){
     
     // Used if there is a conflict in the batch (two or more fingerprints that 
     // would modify the same block) 
@@ -1756,13 +4324,15 @@ namespace CompressedCuckoo{
     for(uint32_t i = 0; i < batch_size; i++){
       block_ids_1[i] = bucket_ids_1[i] / _buckets_per_block; 
       block_ids_2[i] = bucket_ids_2[i] / _buckets_per_block;
-      conflict_vector[i << 1] = conflict_exists<num_buckets>(bf, block_ids_1[i]);
-      conflict_vector[(i << 1) + 1] = conflict_exists<num_buckets>(bf, block_ids_2[i]);
+      conflict_vector[i << 1] = i < count && 
+        conflict_exists<num_buckets>(bf, block_ids_1[i]);
+      conflict_vector[(i << 1) + 1] = i < count && 
+        conflict_exists<num_buckets>(bf, block_ids_2[i]);
     }
 
     if(_handle_conflicts && conflict_vector.any()){ 
       //std::cout << "CONFLICT exists!\n";
-      for(uint32_t i = 0; i < batch_size; i++){
+      for(uint32_t i = 0; i < count; i++){
         statuses[offset + i] = first_level_store(bucket_ids_1[i], 
           fingerprints[i], c1[i]);
         if(!statuses[offset + i]){  // Try again
@@ -1777,10 +4347,10 @@ namespace CompressedCuckoo{
     }
     else{ // Hopefully the common case
       return two_choice_store_many(bucket_ids_1, bucket_ids_2, fingerprints, 
-        block_ids_1, block_ids_2, statuses, offset);
+        block_ids_1, block_ids_2, statuses, offset, first_fit_opt, count);
     }
 
-    for(uint_fast32_t i = 0; i < batch_size; i++){
+    for(uint_fast32_t i = 0; i < count; i++){
       bool status1 = statuses[offset + i];
       InsertStatus status2 = InsertStatus::FAILED_TO_INSERT;
       
@@ -1807,7 +4377,7 @@ namespace CompressedCuckoo{
  
   inline void table_store_many(const ar_hash& bucket_ids,
     const ar_atom& fingerprints, std::vector<bool>& statuses, 
-    const hash_t offset){
+    const hash_t offset, const uint_fast32_t count = batch_size){
 
     ar_store_params c1;  // Bucket/Block candidate 1
     ar_store_params c2;  // Bucket/Block candidate 2
@@ -1825,12 +4395,13 @@ namespace CompressedCuckoo{
     std::bitset<batch_size> conflict_vector;
     for(uint32_t i = 0; i < batch_size; i++){
       block_ids[i] = bucket_ids[i] / _buckets_per_block;
-      conflict_vector[i] = conflict_exists<num_buckets>(bf, block_ids[i]);
+      conflict_vector[i] = i < count && 
+        conflict_exists<num_buckets>(bf, block_ids[i]);
     }
 
     if(__builtin_expect(_handle_conflicts && conflict_vector.any(), 0)){ 
       //std::cout << "CONFLICT exists!\n";
-      for(uint32_t i = 0; i < batch_size; i++){
+      for(uint32_t i = 0; i < count; i++){
         statuses[offset + i] = first_level_store(bucket_ids[i], 
           fingerprints[i], c1[i]); 
       }
@@ -1838,13 +4409,13 @@ namespace CompressedCuckoo{
     else{
       first_level_store_many(bucket_ids, fingerprints, block_ids, 
         counter_indexes, bucket_start_indexes, elements_in_blocks, 
-        counter_values, statuses, offset);
+        counter_values, statuses, offset, count);
       for(uint32_t i = 0; i < batch_size; i++){
         c1[i].block_id = block_ids[i];
         c1[i].counter_index = counter_indexes[i];
       }
     }
-    for(uint_fast32_t i = 0; i < batch_size; i++){
+    for(uint_fast32_t i = 0; i < count; i++){
       bool status1 = statuses[offset + i];
       bool status2 = false;
       InsertStatus status3 = InsertStatus::FAILED_TO_INSERT;
@@ -1955,7 +4526,7 @@ namespace CompressedCuckoo{
 
   
   // Relocation on bucket overflows
-  inline bool try_relocation(hash_t bucket_id, atom_t fingerprint, 
+  INLINE bool try_relocation(hash_t bucket_id, atom_t fingerprint, 
     const StoreParams& sp){
     for(counter_t slot_id = 0; slot_id < sp.counter_value; slot_id++){
         atom_t candidate_fingerprint_to_evict = 
@@ -2091,7 +4662,33 @@ namespace CompressedCuckoo{
   }
 
 
+  // Returns the whole OTA of a block
+  INLINE atom_t read_ota(const hash_t block_id) const{
+    return _storage[block_id].read_cross(_overflow_tracking_array_offset, 
+      _ota_len_bits, 0);
+  }
+
+  // Reads an OTA bit from the block or, if t_from_summary, from the OTA 
+  // summary
+  template<bool t_from_summary = false>
+  INLINE bool read_ota_bit(const hash_t block_id, const hash_t ota_index) 
+    const{
+    if(t_from_summary){
+      return (_ota_summary[block_id] >> ota_index) & 1;
+    }
+    return _storage[block_id].read_bit(_overflow_tracking_array_offset + 
+      ota_index);
+  }
+
+  // Copies a block's OTA to the OTA summary after it changes
+  INLINE void sync_ota_summary(const hash_t block_id){
+    if(ota_summary_enabled()){
+      _ota_summary[block_id] = read_ota(block_id);
+    }
+  }
+
   // This is designed to work with OTAs that are powers of two bits in length.
+  template<bool t_from_summary = false>
   inline bool check_bloom_filter_ota(hash_t bucket_id, atom_t fingerprint,
     const hash_t block_id) const{
     const uint_fast64_t num_hash_fcns = 2;
@@ -2101,8 +4698,7 @@ namespace CompressedCuckoo{
       // Pass in hash rather than true bucket ID
       hash_t ota_index = get_ota_index(hash >> (i * _ota_len_bits), 
         fingerprint);
-      status[i] = _storage[block_id].read_bit(_overflow_tracking_array_offset +
-        ota_index);
+      status[i] = read_ota_bit<t_from_summary>(block_id, ota_index);
     }
     return status.all();
   }
@@ -2115,34 +4711,39 @@ namespace CompressedCuckoo{
     for(uint64_t i = 0; i < num_hash_fcns; i++){
       // Pass in hash rather than true bucket ID
       hash_t ota_index = get_ota_index(hash >> (i * _ota_len_bits), fingerprint);
+      _ota_bits_set += !_storage[block_id].read_bit(
+        _overflow_tracking_array_offset + ota_index);
       _storage[block_id].sticky_set_bit(_overflow_tracking_array_offset + 
         ota_index, 1);
     }
+    sync_ota_summary(block_id);
   }
 
-  // Check whether an OTA bit is set 
+  // Check whether an OTA bit is set.  If t_from_summary, the bit comes from 
+  // the OTA summary, which must be enabled, rather than the block.
+  template<bool t_from_summary = false>
   inline bool get_overflow_status(hash_t bucket_id, atom_t fingerprint) const{
     hash_t ota_index = get_ota_index(bucket_id, fingerprint);
     hash_t block_id = bucket_id / _buckets_per_block;
     // Bloom filter
     if(_use_bloom_ota){ // Not yet implemented for selective Morton filter
-      return check_bloom_filter_ota(bucket_id, fingerprint, block_id);
+      return check_bloom_filter_ota<t_from_summary>(bucket_id, fingerprint, 
+        block_id);
     }
     // Bit vector
     constexpr bool using_selective_mf = _ota_lbi_insertion_threshold > - 1;
     if(using_selective_mf){
       hash_t lbi = bucket_id % _buckets_per_block;
-      return _storage[block_id].read_bit(_overflow_tracking_array_offset + 
-        ota_index) | (static_cast<int16_t>(lbi) <= _ota_lbi_insertion_threshold);
+      return read_ota_bit<t_from_summary>(block_id, ota_index) | 
+        (static_cast<int16_t>(lbi) <= _ota_lbi_insertion_threshold);
     }
     else{
-      return _storage[block_id].read_bit(_overflow_tracking_array_offset + 
-        ota_index);
+      return read_ota_bit<t_from_summary>(block_id, ota_index);
     }
   }
  
   // Set OTA bit on overflow if not already set
-  inline void set_overflow_status(const hash_t bucket_id, 
+  INLINE void set_overflow_status(const hash_t bucket_id, 
     const atom_t fingerprint, const hash_t block_id, const hash_t lbi){
     // Bloom filter    
     if(_use_bloom_ota){ // Not yet implemented for selective Morton filter
@@ -2150,6 +4751,8 @@ namespace CompressedCuckoo{
     }
     // Bit vector
     hash_t ota_index = get_ota_index(bucket_id, fingerprint);
+    const bool was_set = _storage[block_id].read_bit(
+      _overflow_tracking_array_offset + ota_index);
     constexpr bool using_selective_mf = _ota_lbi_insertion_threshold > -1;
     if(using_selective_mf){
       _storage[block_id].sticky_set_bit(
@@ -2160,9 +4763,193 @@ namespace CompressedCuckoo{
       _storage[block_id].sticky_set_bit(
         _overflow_tracking_array_offset + ota_index, 1); 
     }
+    _ota_bits_set += _storage[block_id].read_bit(
+      _overflow_tracking_array_offset + ota_index) & !was_set;
+    sync_ota_summary(block_id);
+  }
+
+  // Returns a random number in [0, n) from the filter's xorshift64* 
+  // generator, which is much cheaper than rand() and doesn't take a lock
+  INLINE uint64_t random_below(uint64_t n){
+    return util::fast_mod_alternative<uint64_t>(
+      util::xorshift64star(_rng_state) >> 32, n, 32);
+  }
+
+  // Returns whether bucket_id has a free slot and its block has room
+  INLINE bool bucket_has_room(hash_t bucket_id) const{
+    const hash_t block_id = bucket_id / _buckets_per_block;
+    return (read_counter(block_id, bucket_id % _buckets_per_block) < 
+      _slots_per_bucket) & (get_bucket_start_index(block_id, 
+      _buckets_per_block) < _max_fingerprints_per_block);
+  }
+
+  // Adds block_id to the cuckoo path search's set of visited blocks.  
+  // Returns false if it was already in it.
+  INLINE bool visit_block(hash_t block_id){
+    const uint64_t mask = _cuckoo_path_visited_blocks.size() - 1;
+    uint64_t i = ((block_id * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+    while(_cuckoo_path_visited_blocks[i] != 0){
+      if(_cuckoo_path_visited_blocks[i] == block_id + 1){
+        return false;
+      }
+      i = (i + 1) & mask;
+    }
+    _cuckoo_path_visited_blocks[i] = block_id + 1;
+    return true;
+  }
+
+  // Breadth-first search for the shortest chain of moves that frees a slot 
+  // in bucket_id or secondary_bucket_id, which is how Li et al. (EuroSys'14)
+  // make room in cuckoo hash tables.  Unlike random_kickout_cuckoo, nothing 
+  // is moved until a whole path is found, so a failed search leaves the 
+  // table as it was rather than dropping a fingerprint.
+  // A node's bucket needs a free slot.  If the bucket is full, one of its 
+  // fingerprints has to move to its alternate bucket.  Otherwise the block 
+  // is full, and any of the block's fingerprints can move.  Full blocks have
+  // dozens of fingerprints to choose from, so each level of the search is 
+  // capped at _cuckoo_path_max_breadth nodes, split evenly between the 
+  // nodes of the level above, and it goes at most _cuckoo_path_max_depth 
+  // levels deep.  The cap matters.  Alternate buckets are nearby, so at 
+  // high load a bucket's neighbors tend to be full too, and a deep, narrow 
+  // search that gets away from them succeeds more often than a wide one 
+  // that visits as many blocks.  Each block is only visited once, so that 
+  // overlapping paths don't recheck the same blocks, and every block along 
+  // a path loses one fingerprint and gains one.  That way the counts that 
+  // the search reads stay true when execute_cuckoo_path replays the path.  
+  // The blocks of each level are prefetched while the level above it is 
+  // checked.  Returns the index of the node with room in _cuckoo_path_nodes 
+  // or -1 if there isn't one within the bounds.
+  NOINLINE int32_t find_cuckoo_path(hash_t bucket_id, 
+    hash_t secondary_bucket_id){
+    std::vector<CuckooPathNode>& nodes = _cuckoo_path_nodes;
+    nodes.clear();
+    std::fill(_cuckoo_path_visited_blocks.begin(), 
+      _cuckoo_path_visited_blocks.end(), 0);
+    nodes.push_back({bucket_id, 0, -1, 0, 0, 0});
+    visit_block(bucket_id / _buckets_per_block);
+    nodes.push_back({secondary_bucket_id, 0, -1, 0, 0, 0});
+    visit_block(secondary_bucket_id / _buckets_per_block);
+    // The level that head is in is [level_start, level_end).  Its nodes may 
+    // add up to children_per_node nodes each to the next level until it has
+    // _cuckoo_path_max_breadth nodes, which is at next_level_cap.
+    uint64_t level_start = 0;
+    uint64_t level_end = 0;
+    uint64_t children_per_node = 0;
+    uint64_t next_level_cap = 0;
+    for(uint32_t head = 0; head < nodes.size(); head++){
+      if(bucket_has_room(nodes[head].bucket_id)){
+        return head;
+      }
+      if(head == level_end){
+        level_start = level_end;
+        level_end = nodes.size();
+        children_per_node = (_cuckoo_path_max_breadth + level_end - 
+          level_start - 1) / (level_end - level_start);
+        next_level_cap = level_end + _cuckoo_path_max_breadth;
+      }
+      if(nodes[head].depth == _cuckoo_path_max_depth){
+        continue;
+      }
+      const uint64_t children_end = std::min<uint64_t>(next_level_cap, 
+        nodes.size() + children_per_node);
+      const hash_t block_id = nodes[head].bucket_id / _buckets_per_block;
+      const uint16_t lbi = nodes[head].bucket_id % _buckets_per_block;
+      const counter_t bucket_load = read_counter(block_id, lbi);
+      const bool bucket_full = bucket_load == _slots_per_bucket;
+      // Start at a random bucket (or slot if only the node's bucket will do) 
+      // so that searches that pass through the same block don't keep trying
+      // the same fingerprints
+      const uint16_t num_candidate_buckets = bucket_full ? 1 : 
+        _buckets_per_block;
+      const uint16_t first_bucket = bucket_full ? lbi : 
+        random_below(_buckets_per_block);
+      const counter_t first_slot = bucket_full ? 
+        random_below(bucket_load) : 0;
+      for(uint16_t i = 0; i < num_candidate_buckets && 
+        nodes.size() < children_end; i++){
+        uint16_t eviction_lbi = first_bucket + i;
+        eviction_lbi -= eviction_lbi >= _buckets_per_block ? 
+          _buckets_per_block : 0;
+        const counter_t occupied_slots = read_counter(block_id, eviction_lbi);
+        const counter_t bucket_start_index = get_bucket_start_index(block_id,
+          eviction_lbi);
+        const hash_t eviction_bucket_id = block_id * _buckets_per_block + 
+          eviction_lbi;
+        for(counter_t j = 0; j < occupied_slots && 
+          nodes.size() < children_end; j++){
+          counter_t slot = first_slot + j;
+          slot -= slot >= occupied_slots ? occupied_slots : 0;
+          const atom_t fingerprint = read_fingerprint(block_id, 
+            bucket_start_index + slot);
+          const hash_t alternate_bucket_id = determine_alternate_bucket(
+            eviction_bucket_id, fingerprint);
+          const hash_t alternate_block_id = alternate_bucket_id / 
+            _buckets_per_block;
+          if(!visit_block(alternate_block_id)){
+            continue;
+          }
+          prefetch_block(alternate_block_id);
+          nodes.push_back({alternate_bucket_id, fingerprint, 
+            static_cast<int32_t>(head), eviction_lbi, 
+            static_cast<uint16_t>(slot), 
+            static_cast<uint16_t>(nodes[head].depth + 1)});
+        }
+      }
+    }
+    return -1;
   }
 
-  inline bool random_kickout_cuckoo(hash_t bucket_id, atom_t fingerprint){
+  // Makes the moves along the path that ends at node end_index of 
+  // _cuckoo_path_nodes, starting with the last one so that each move fills 
+  // the slot that the move after it freed, and then stores fingerprint in 
+  // the root's bucket.  OTA bits are set for the fingerprints that were 
+  // moved but not for the new fingerprint.  Returns the root's index (0 is 
+  // the primary bucket and 1 the secondary).
+  inline int32_t execute_cuckoo_path(int32_t end_index, atom_t fingerprint){
+    StoreParams sp;
+    int32_t n = end_index;
+    for(; _cuckoo_path_nodes[n].parent != -1; 
+      n = _cuckoo_path_nodes[n].parent){
+      const CuckooPathNode& node = _cuckoo_path_nodes[n];
+      const hash_t block_id = _cuckoo_path_nodes[node.parent].bucket_id / 
+        _buckets_per_block;
+      // Always succeeds since the path doesn't revisit blocks
+      first_level_store(node.bucket_id, node.fingerprint, sp);
+      const counter_t occupied_slots = read_counter(block_id, node.lbi);
+      delete_fingerprint_right_displace(_storage[block_id], 
+        get_bucket_start_index(block_id, node.lbi) + node.slot);
+      decrement_fullness_counter(_storage[block_id], node.lbi, 
+        occupied_slots);
+      if(_morton_filter_functionality_enabled){
+        set_overflow_status(block_id * _buckets_per_block + node.lbi, 
+          node.fingerprint, block_id, node.lbi);
+      }
+    }
+    first_level_store(_cuckoo_path_nodes[n].bucket_id, fingerprint, sp);
+    return n;
+  }
+
+  // Places fingerprint in bucket_id or secondary_bucket_id when neither has
+  // room, by moving other fingerprints out of the way.  The caller sets the 
+  // OTA bit if it's placed in the secondary bucket.
+  NOINLINE InsertStatus make_room_and_store(hash_t bucket_id, 
+    hash_t secondary_bucket_id, atom_t fingerprint){
+    if(_cuckoo_path_max_depth == 0){
+      return random_kickout_cuckoo(bucket_id, fingerprint) ? 
+        InsertStatus::PLACED_IN_PRIMARY_BUCKET : 
+        InsertStatus::FAILED_TO_INSERT;
+    }
+    const int32_t end_index = find_cuckoo_path(bucket_id, 
+      secondary_bucket_id);
+    if(end_index == -1){
+      return InsertStatus::FAILED_TO_INSERT;
+    }
+    return execute_cuckoo_path(end_index, fingerprint) == 0 ? 
+      InsertStatus::PLACED_IN_PRIMARY_BUCKET : 
+      InsertStatus::PLACED_IN_SECONDARY_BUCKET;
+  }
+
+  NOINLINE bool random_kickout_cuckoo(hash_t bucket_id, atom_t fingerprint){
     uint_fast16_t max_count = 300; // 40 works for many configurations
     uint_fast16_t count = 1;
     
@@ -2248,11 +5035,11 @@ namespace CompressedCuckoo{
         // Slow but functional way to get the block-local bucket ID of a 
         // non-empty bucket
         do{
-          eviction_bucket_id = rand() % (_buckets_per_block);
+          eviction_bucket_id = random_below(_buckets_per_block);
           eviction_bucket_count = read_counter(block_id, eviction_bucket_id);
         } while(eviction_bucket_count == 0);
         // 1b) Select a random slot and cache the fingerprint f3
-        hash_t eviction_slot_id = rand() % eviction_bucket_count;
+        hash_t eviction_slot_id = random_below(eviction_bucket_count);
         hash_t eviction_bucket_offset = get_bucket_start_index(block_id, 
           eviction_bucket_id); 
         atom_t f3 = read_fingerprint(block_id, 
@@ -2294,8 +5081,10 @@ namespace CompressedCuckoo{
     } // End of while loop
     //std::cout << "MAX LOOP COUNT EXCEEDED\n";
     // If you exit the while loop here, it means that the max count has been 
-    // exceeded.
-    return false; 
+    // exceeded.  The original fingerprint is in the table by now, so it's 
+    // the one that we're left holding that goes to the stash.  It's only 
+    // lost if the stash is full.
+    return stash_insert(bucket_id, fingerprint);
   }
 
   inline void double_capacity(){
@@ -2326,8 +5115,15 @@ namespace CompressedCuckoo{
     uint64_t new_total_slots = new_total_buckets * _slots_per_bucket; // Virtual not actual
     uint64_t new_total_blocks = (new_total_slots + _slots_per_bucket * _buckets_per_block - 1) / (_slots_per_bucket * _buckets_per_block); // Round up to next whole block
     //std::vector<bool> new_block_fullness_array(_block_fullness_array_enabled ? new_total_blocks : 0, 0);
-    block_t* new_storage = allocate_cache_aligned_storage(new_total_blocks);
+    size_t new_storage_mapped_bytes;
+    block_t* new_storage = allocate_cache_aligned_storage(new_total_blocks, 
+      new_storage_mapped_bytes);
     block_t* old_storage = _storage;
+    if(new_storage == NULL){
+      std::cerr << "ERROR: Allocating table memory failed during resize" << 
+        std::endl;
+      exit(1);
+    }
 
     for(uint64_t block_id = 0; block_id < _total_blocks; block_id++){
       // Tracks how many fingerprints have been added already to each of the 
@@ -2355,21 +5151,45 @@ namespace CompressedCuckoo{
         new_storage[new_block_id].add_cross(_overflow_tracking_array_offset, _ota_len_bits, 0, ota);
       }
     }
+    // Stash entries move to the buckets that their fingerprints would have
+    // moved to
+    for(stash_entry_t& entry : _stash){
+      const hash_t block_id = entry.first / _buckets_per_block;
+      const hash_t new_block = resize_factor * block_id + ((entry.second >> 
+        (_fingerprint_len_bits - _resize_count - log2_resize)) & 
+        (resize_factor - one));
+      entry.first = new_block * _buckets_per_block + 
+        entry.first % _buckets_per_block;
+    }
+    std::sort(_stash.begin(), _stash.end());
     _total_buckets = new_total_buckets;
     _total_slots = new_total_slots;
     _total_blocks = new_total_blocks;
     _storage = new_storage;
     // TODO: Finish implementing _block_fullness_array = new_block_fullness_array;
     _resize_count+=log2_resize;
-    free(old_storage); // FIXME: Only works with the aligned_alloc call
+    // Each OTA was copied to resize_factor blocks
+    _ota_bits_set *= resize_factor;
+    if(ota_summary_enabled()){
+      enable_ota_summary(); // Rebuild it for the new blocks
+    }
+    // FIXME: Only works with the g_cache_aligned_allocate allocations
+    free_block_storage(old_storage, _storage_mapped_bytes);
+    _storage_mapped_bytes = new_storage_mapped_bytes;
+    // There's plenty of room now
+    update_stash_tag_shift();
+    drain_whole_stash();
+    // Bucket ids changed, so the prefilter's entries did too, and false 
+    // positives may have come or gone
+    rebuild_prefilter();
+    clear_hot_key_cache();
   }
 
   // The main function for resolving collisions during insertions.  It does 
-  // a two level breadth-first search but then reverts to using a Morton- 
-  // filter-specific variant of Fan et al.'s random kickout 
-  // algorithm (random_kickout_cuckoo).
+  // a two level breadth-first search but then reverts to a bounded search 
+  // for a longer cuckoo path (make_room_and_store).
   // I did this to avoid storing explored paths and keeping track 
-  // of visited nodes.  It didn't seem worth the overhead since the 
+  // of visited nodes for the common case, since the 
   // vast majority of collisions can be resolved by looking solely at 
   // the primary and secondary blocks.  For those that remain, most 
   // are resolvable by going just one level 
@@ -2414,16 +5234,11 @@ namespace CompressedCuckoo{
       return InsertStatus::PLACED_IN_SECONDARY_BUCKET;
     }
      
-    InsertStatus return_status = random_kickout_cuckoo(bucket_id, fingerprint) ? 
-      InsertStatus::PLACED_IN_PRIMARY_BUCKET : 
-      InsertStatus::FAILED_TO_INSERT;
-    return return_status; 
-    
-    return InsertStatus::FAILED_TO_INSERT;
+    return make_room_and_store(bucket_id, secondary_bucket_id, fingerprint);
   } 
 
   // Store the fingerprint in the bucket specified by bucket_id
-  inline bool table_store(hash_t bucket_id, atom_t fingerprint){
+  NOINLINE bool table_store(hash_t bucket_id, atom_t fingerprint){
     StoreParams c1;  // Bucket/Block candidate 1
     StoreParams c2;  // Bucket/Block candidate 2
     bool status1 = first_level_store(bucket_id, fingerprint, c1);
@@ -2446,6 +5261,9 @@ namespace CompressedCuckoo{
 
     bool net_status = status1 | status2 | 
       (status3 != InsertStatus::FAILED_TO_INSERT);
+    if(!net_status){
+      net_status = stash_insert(bucket_id, fingerprint);
+    }
 
     if(_print_access_counts && (status1 | status2)){
       std::cout << status1 + (status2 << 1) << ",0,0,0" << std::endl;
@@ -2453,7 +5271,8 @@ namespace CompressedCuckoo{
 
     if(/*_DEBUG &&*/ !net_status){
       std::cerr << "Table store failed on bucket " << bucket_id << 
-        " and fingerprint " << fingerprint << ".\n" << std::endl;
+        " and fingerprint " << fingerprint << " (the stash is full).\n" << 
+        std::endl;
     }
     return net_status;
   }
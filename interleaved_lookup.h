@@ -0,0 +1,241 @@
+/*
+Copyright (c) 2019 Advanced Micro Devices, Inc.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+Author: Alex D. Breslow 
+        Advanced Micro Devices, Inc.
+        AMD Research
+
+Code Source: https://github.com/AMDComputeLibraries/morton_filter
+
+VLDB 2018 Paper: https://www.vldb.org/pvldb/vol11/p1041-breslow.pdf
+
+How To Cite:
+  Alex D. Breslow and Nuwan S. Jayasena. Morton Filters: Faster, Space-Efficient
+  Cuckoo Filters Via Biasing, Compression, and Decoupled Logical Sparsity. PVLDB,
+  11(9):1041-1055, 2018
+  DOI: https://doi.org/10.14778/3213880.3213884
+
+*/
+#ifndef _INTERLEAVED_LOOKUP_H
+#define _INTERLEAVED_LOOKUP_H
+
+// An interleaved execution engine for point lookups in the style of 
+// asynchronous memory access chaining (AMAC).  See "Asynchronous Memory 
+// Access Chaining" by Kocberber et al. in PVLDB'15.
+// URL: http://www.vldb.org/pvldb/vol9/p252-kocberber.pdf
+//
+// likely_contains stalls on the DRAM access to the primary block (and 
+// sometimes a second one to the secondary block).  likely_contains_many hides
+// those stalls, but only if the caller can accumulate batches of keys.  This 
+// engine keeps up to t_max_in_flight independent lookups in flight instead.  
+// Each lookup is a small state machine that prefetches the block it needs 
+// next and then yields so that the other lookups can make progress while the
+// block is on its way.  By the time the engine gets back around to it, the 
+// block is likely in the cache.  Each submitted key costs about one state 
+// machine step, so the latency of a lookup is bounded by t_max_in_flight 
+// steps rather than by how long it takes to fill a batch.
+//
+// Usage:
+//   InterleavedLookupEngine<Morton3_8> engine(mf);
+//   auto on_complete = [&](uint64_t tag, bool found){ ... };
+//   for each incoming query: engine.submit(key, tag, on_complete);
+//   engine.flush(on_complete); // When there's a lull in queries
+//
+// on_complete may be called from within submit for earlier keys, in the 
+// order in which the lookups finish, which isn't necessarily the order in 
+// which they were submitted.  The filter must not be modified while lookups
+// are in flight.
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "vector_types.h"
+
+#define INLINE __attribute__((always_inline)) inline
+
+namespace CompressedCuckoo{
+  template<class FILTER, uint_fast16_t t_max_in_flight = 16>
+  class InterleavedLookupEngine{
+    static_assert(t_max_in_flight > 0, "Need at least one lookup in flight");
+
+    enum struct Stage : uint8_t{
+      EMPTY,
+      PRIMARY,   // The primary block has been prefetched
+      SECONDARY  // The secondary block has been prefetched
+    };
+
+    struct Lookup{
+      Stage stage = Stage::EMPTY;
+      bool found = false;
+      // Set if the secondary block was prefetched along with the primary one
+      bool secondary_prefetched = false;
+      atom_t fingerprint;
+      hash_t bucket_id; // The bucket that the next step will read
+      // Kept because bucket_id moves on to the secondary bucket, and the 
+      // stash is keyed on the primary one
+      hash_t primary_bucket_id;
+      hash_t secondary_bucket_id; // Only valid if secondary_prefetched
+      uint64_t tag;
+    };
+
+    const FILTER& _filter;
+    std::array<Lookup, t_max_in_flight> _lookups;
+    uint_fast16_t _cursor = 0; // The next lookup to step, round robin
+    uint_fast16_t _in_flight = 0;
+
+    // Checks the overflow stash, which the table lookups don't, before 
+    // reporting the lookup as finished.  It's a load and a branch when the 
+    // stash is empty.
+    INLINE bool finish(Lookup& lookup) const{
+      lookup.found = lookup.found || _filter.stash_contains(
+        lookup.primary_bucket_id, lookup.fingerprint);
+      return true;
+    }
+
+    // Advances a lookup by one stage.  Returns true if it has finished.
+    INLINE bool step(Lookup& lookup) const{
+      const bool found = _filter.table_read_and_compare(lookup.bucket_id, 
+        lookup.fingerprint);
+      if(lookup.stage == Stage::SECONDARY || !FILTER::_remap_enabled){
+        lookup.found |= found;
+        return finish(lookup);
+      }
+      // Stage::PRIMARY
+      lookup.found = found;
+      if(!FILTER::_morton_filter_functionality_enabled){
+        // Compressed cuckoo filters always check both buckets, so the 
+        // secondary block was prefetched together with the primary one.
+        lookup.bucket_id = lookup.secondary_bucket_id;
+        lookup.stage = Stage::SECONDARY;
+        return false;
+      }
+      // Morton filters only need the secondary bucket if the primary 
+      // block's OTA says that the fingerprint might have overflowed, which 
+      // is rare at most loads.
+      if(found || !_filter.get_overflow_status(lookup.bucket_id, 
+        lookup.fingerprint)){
+        return finish(lookup);
+      }
+      if(lookup.secondary_prefetched){
+        lookup.bucket_id = lookup.secondary_bucket_id;
+      }
+      else{
+        lookup.bucket_id = _filter.determine_alternate_bucket(
+          lookup.bucket_id, lookup.fingerprint);
+        _filter.prefetch_block(lookup.bucket_id / FILTER::_buckets_per_block);
+      }
+      lookup.stage = Stage::SECONDARY;
+      return false;
+    }
+
+    template<class CALLBACK>
+    INLINE void step_and_complete(Lookup& lookup, CALLBACK& on_complete){
+      if(step(lookup)){
+        lookup.stage = Stage::EMPTY;
+        _in_flight--;
+        on_complete(lookup.tag, lookup.found);
+      }
+    }
+
+    // Steps the lookups round robin until the one at _cursor is free.  It 
+    // has all of the step code in it, so it's left to the compiler whether 
+    // to inline it.  Forcing it into submit made submit too big to inline 
+    // into the caller's loop.
+    template<class CALLBACK>
+    void wait_for_free_lookup(CALLBACK& on_complete){
+      while(_lookups[_cursor].stage != Stage::EMPTY){
+        step_and_complete(_lookups[_cursor], on_complete);
+        if(_lookups[_cursor].stage != Stage::EMPTY){
+          _cursor = (_cursor + 1) % t_max_in_flight;
+        }
+      }
+    }
+
+  public:
+    explicit InterleavedLookupEngine(const FILTER& filter) : _filter(filter){}
+
+    // Starts the lookup of key.  If all t_max_in_flight lookups are busy, it
+    // first steps them round robin until one of them finishes, which calls 
+    // on_complete(tag, found) for it.
+    template<class CALLBACK>
+    inline void submit(const keys_t key, const uint64_t tag, 
+      CALLBACK& on_complete){
+      wait_for_free_lookup(on_complete);
+      Lookup& lookup = _lookups[_cursor];
+      const hash_t raw_hash = _filter.raw_primary_hash(key);
+      lookup.fingerprint = _filter.fingerprint_function(raw_hash);
+      lookup.bucket_id = _filter.map_to_bucket(raw_hash, 
+        _filter._total_buckets);
+      lookup.primary_bucket_id = lookup.bucket_id;
+      lookup.tag = tag;
+      lookup.found = false;
+      lookup.stage = Stage::PRIMARY;
+      _filter.prefetch_block(lookup.bucket_id / FILTER::_buckets_per_block);
+      // Compressed cuckoo filters always need the secondary block.  Morton 
+      // filters with an OTA summary can tell up front that they might.
+      lookup.secondary_prefetched = FILTER::_remap_enabled && 
+        (!FILTER::_morton_filter_functionality_enabled || 
+        (_filter.ota_summary_enabled() && 
+        _filter.template get_overflow_status<true>(lookup.bucket_id, 
+        lookup.fingerprint)));
+      if(lookup.secondary_prefetched){
+        lookup.secondary_bucket_id = _filter.determine_alternate_bucket(
+          lookup.bucket_id, lookup.fingerprint);
+        _filter.prefetch_block(lookup.secondary_bucket_id / 
+          FILTER::_buckets_per_block);
+      }
+      _in_flight++;
+      _cursor = (_cursor + 1) % t_max_in_flight;
+    }
+
+    // Finishes every lookup that is in flight
+    template<class CALLBACK>
+    inline void flush(CALLBACK& on_complete){
+      while(_in_flight){
+        if(_lookups[_cursor].stage != Stage::EMPTY){
+          step_and_complete(_lookups[_cursor], on_complete);
+        }
+        _cursor = (_cursor + 1) % t_max_in_flight;
+      }
+    }
+
+    inline uint_fast16_t in_flight() const{
+      return _in_flight;
+    }
+
+    // Streams num_keys keys through the engine and stores the result for 
+    // keys[i] in status[i].  Mostly useful for benchmarking the engine 
+    // against likely_contains_many.
+    inline void likely_contains_many(const keys_t* keys, 
+      const uint64_t num_keys, std::vector<bool>& status){
+      auto on_complete = [&status](uint64_t tag, bool found){
+        status[tag] = found;
+      };
+      for(uint64_t i = 0; i < num_keys; i++){
+        submit(keys[i], i, on_complete);
+      }
+      flush(on_complete);
+    }
+  };
+}
+
+#endif // End of file guards
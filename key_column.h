@@ -0,0 +1,172 @@
+/*
+Copyright (c) 2019 Advanced Micro Devices, Inc.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+Author: Alex D. Breslow 
+        Advanced Micro Devices, Inc.
+        AMD Research
+
+Code Source: https://github.com/AMDComputeLibraries/morton_filter
+
+VLDB 2018 Paper: https://www.vldb.org/pvldb/vol11/p1041-breslow.pdf
+
+How To Cite:
+  Alex D. Breslow and Nuwan S. Jayasena. Morton Filters: Faster, Space-Efficient
+  Cuckoo Filters Via Biasing, Compression, and Decoupled Logical Sparsity. PVLDB,
+  11(9):1041-1055, 2018
+  DOI: https://doi.org/10.14778/3213880.3213884
+
+*/
+#ifndef _KEY_COLUMN_H
+#define _KEY_COLUMN_H
+
+// Describes a column of keys as it sits in someone else's memory (e.g., an 
+// Arrow array or a field of an array of row structs) so that the batch APIs 
+// can read it in place.  Row r's key is the width_bytes-byte unsigned 
+// integer at base + r * stride_bytes, zero extended to keys_t, so a 32-bit 
+// key and a 64-bit key with the same value are the same key.  validity is an
+// optional Arrow-style bitmap (bit validity_offset + r, least significant bit
+// first, is 1 if row r isn't null).  With no bitmap, every row is valid.
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#define INLINE __attribute__((always_inline)) inline
+
+namespace CompressedCuckoo{
+  struct KeyColumn{
+    const uint8_t* _base;
+    uint64_t _num_rows;
+    uint64_t _stride_bytes;
+    uint32_t _width_bytes;
+    const uint8_t* _validity;
+    uint64_t _validity_offset;
+
+    KeyColumn(const void* base, uint64_t num_rows, uint64_t stride_bytes, 
+      uint32_t width_bytes, const uint8_t* validity = nullptr, 
+      uint64_t validity_offset = 0) : 
+      _base(static_cast<const uint8_t*>(base)), _num_rows(num_rows), 
+      _stride_bytes(stride_bytes), _width_bytes(width_bytes), 
+      _validity(validity), _validity_offset(validity_offset){
+      if(width_bytes != 1 && width_bytes != 2 && width_bytes != 4 && 
+        width_bytes != 8){
+        std::cerr << "KeyColumn keys must be 1, 2, 4, or 8 bytes wide, not " 
+          << width_bytes << "\n";
+        exit(1);
+      }
+    }
+
+    // A dense column of KEY_T, e.g., an Arrow Int32Array's values
+    template<class KEY_T>
+    static KeyColumn dense(const KEY_T* keys, uint64_t num_rows, 
+      const uint8_t* validity = nullptr, uint64_t validity_offset = 0){
+      return KeyColumn(keys, num_rows, sizeof(KEY_T), sizeof(KEY_T), validity,
+        validity_offset);
+    }
+
+    INLINE bool has_nulls() const{
+      return _validity != nullptr;
+    }
+
+    INLINE bool valid(uint64_t row) const{
+      const uint64_t bit = _validity_offset + row;
+      return _validity == nullptr || ((_validity[bit / 8] >> (bit % 8)) & 1);
+    }
+
+    // Bit i is the validity of row first + i for i < min(count, 64).  Only 
+    // reads the bytes of the bitmap that hold those rows' bits.
+    INLINE uint64_t valid_bits(uint64_t first, uint64_t count) const{
+      count = count < 64 ? count : 64;
+      const uint64_t mask = count >= 64 ? ~static_cast<uint64_t>(0) : 
+        (static_cast<uint64_t>(1) << count) - 1;
+      if(_validity == nullptr){
+        return mask;
+      }
+      const uint64_t bit = _validity_offset + first;
+      const uint64_t shift = bit % 8;
+      const uint64_t bytes = (shift + count + 7) / 8;
+      const uint8_t* p = _validity + bit / 8;
+      uint64_t bits = 0;
+      for(uint64_t i = 0; i < bytes && i < 8; i++){
+        bits |= static_cast<uint64_t>(p[i]) << (8 * i);
+      }
+      bits >>= shift;
+      if(bytes > 8){ // The 9th byte has the top shift bits
+        bits |= static_cast<uint64_t>(p[8]) << (64 - shift);
+      }
+      return bits & mask;
+    }
+
+    // Copies the keys of rows [first, first + count) to keys.  Null rows are 
+    // copied too, since whatever bytes they hold are still readable.  The 
+    // switch is outside of the loop so that each width gets its own loop.
+    template<class KEY_T>
+    INLINE void gather(uint64_t first, uint64_t count, KEY_T* keys) const{
+      switch(_width_bytes){
+        case 1: gather_width<uint8_t>(first, count, keys); break;
+        case 2: gather_width<uint16_t>(first, count, keys); break;
+        case 4: gather_width<uint32_t>(first, count, keys); break;
+        default: gather_width<uint64_t>(first, count, keys); break;
+      }
+    }
+
+    template<class WIDTH_T, class KEY_T>
+    INLINE void gather_width(uint64_t first, uint64_t count, KEY_T* keys) 
+      const{
+      const uint8_t* p = _base + first * _stride_bytes;
+      for(uint64_t i = 0; i < count; i++, p += _stride_bytes){
+        WIDTH_T key;
+        memcpy(&key, p, sizeof(key));
+        keys[i] = static_cast<KEY_T>(key);
+      }
+    }
+  };
+
+  // Wraps another output policy (see batch_output.h) and clears the results 
+  // of null rows before passing them on.  first_row is the row of the 
+  // column that the wrapped lookup's key 0 came from.
+  template<class OUTPUT>
+  struct ValidityMaskedOutput{
+    OUTPUT& _output;
+    const KeyColumn& _column;
+    uint64_t _first_row;
+    ValidityMaskedOutput(OUTPUT& output, const KeyColumn& column, 
+      uint64_t first_row) : _output(output), _column(column), 
+      _first_row(first_row){}
+
+    template<size_t W>
+    INLINE void write(uint64_t offset, const std::array<uint64_t, W>& found, 
+      uint64_t count){
+      std::array<uint64_t, W> masked = found;
+      if(_column.has_nulls()){
+        for(uint64_t w = 0; w * 64 < count; w++){
+          masked[w] &= _column.valid_bits(_first_row + offset + w * 64, 
+            count - w * 64);
+        }
+      }
+      _output.write(_first_row + offset, masked, count);
+    }
+  };
+}
+
+#endif // End of file guards
@@ -40,5 +40,6 @@ How To Cite:
 // The main implementation is in compressed_cuckoo_filter.h.
 
 #include "morton_sample_configs.h"
+#include "interleaved_lookup.h" // Point lookups without batching
 
 #endif
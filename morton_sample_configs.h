@@ -178,7 +178,7 @@ typedef CompressedCuckooFilter<
   true, // Morton filter functionality enabled
   false, // Block fullness array enabled
   true,  // Handle conflicts on insertions enabled
-  FingerprintComparisonMethodEnum::VARIABLE_COUNT
+  FingerprintComparisonMethodEnum::SIMD_MASK
   > Morton7_8;
 
 // 15-slot configuration from the VLDB'18 paper
@@ -470,7 +470,7 @@ typedef CompressedCuckooFilter<
   true, // Morton filter functionality enabled
   false, // Block fullness array enabled
   true,  // Handle conflicts on insertions enabled
-  FingerprintComparisonMethodEnum::VARIABLE_COUNT
+  FingerprintComparisonMethodEnum::SIMD_MASK
   > Morton15_16;
 
 // 3-slot bucket with 18-bit fingerprints
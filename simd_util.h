@@ -0,0 +1,182 @@
+/*
+Copyright (c) 2019 Advanced Micro Devices, Inc.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+Author: Alex D. Breslow 
+        Advanced Micro Devices, Inc.
+        AMD Research
+
+Code Source: https://github.com/AMDComputeLibraries/morton_filter
+
+VLDB 2018 Paper: https://www.vldb.org/pvldb/vol11/p1041-breslow.pdf
+
+How To Cite:
+  Alex D. Breslow and Nuwan S. Jayasena. Morton Filters: Faster, Space-Efficient
+  Cuckoo Filters Via Biasing, Compression, and Decoupled Logical Sparsity. PVLDB,
+  11(9):1041-1055, 2018
+  DOI: https://doi.org/10.14778/3213880.3213884
+
+*/
+#ifndef _SIMD_UTIL_H
+#define _SIMD_UTIL_H
+
+// SIMD kernels that operate on a single 512-bit block or on one word from 
+// each of eight blocks.  Each kernel has an AVX-512 and an AVX2 
+// implementation and a plain C++ fallback, selected at compile time based on 
+// what -march enables.
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__AVX512BW__)
+#include <immintrin.h>
+#endif
+
+#define INLINE __attribute__((always_inline)) inline
+
+namespace CompressedCuckoo{
+  constexpr uint64_t simd_line_size_bytes = 64;
+
+  // Eight 64-bit lanes.  GCC splits it into two registers on AVX2.
+  typedef uint64_t v8_u64 __attribute__((vector_size(64)));
+  constexpr uint64_t v8_lanes = 8;
+
+  // Per-lane popcount.  Uses VPOPCNTQ if available, and otherwise a nibble 
+  // lookup table with VPSHUFB and VPSADBW to sum the bytes of each lane.
+  INLINE v8_u64 popcount8(v8_u64 v){
+#if defined(__AVX512VPOPCNTDQ__)
+    return reinterpret_cast<v8_u64>(_mm512_popcnt_epi64(
+      reinterpret_cast<__m512i>(v)));
+#elif defined(__AVX2__)
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 
+      2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+    __m256i halves[2];
+    memcpy(halves, &v, sizeof(v));
+    for(uint32_t h = 0; h < 2; h++){
+      __m256i lo = _mm256_and_si256(halves[h], low_nibbles);
+      __m256i hi = _mm256_and_si256(_mm256_srli_epi16(halves[h], 4), 
+        low_nibbles);
+      __m256i byte_counts = _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo), 
+        _mm256_shuffle_epi8(lut, hi));
+      halves[h] = _mm256_sad_epu8(byte_counts, _mm256_setzero_si256());
+    }
+    memcpy(&v, halves, sizeof(v));
+    return v;
+#else
+    for(uint32_t i = 0; i < v8_lanes; i++){
+      v[i] = __builtin_popcountll(v[i]);
+    }
+    return v;
+#endif
+  }
+
+  // Per-lane (1 << bits) - 1 for 0 <= bits <= 64.  Shifting a 64-bit lane by 
+  // 64 is undefined, so the shift is split in two.
+  INLINE v8_u64 low_bits_mask8(v8_u64 bits){
+    const v8_u64 half = bits >> 1;
+    return ((static_cast<uint64_t>(1) << half) << (bits - half)) - 1;
+  }
+
+  // Loads the unaligned 64-bit word at base + byte_offsets[l] into lane l.  
+  // This is a single VPGATHERQQ on AVX-512 and two on AVX2.  Byte offsets must 
+  // be less than 2^63 since the gathers treat the indexes as signed.
+  INLINE v8_u64 gather8_u64(const void* base, v8_u64 byte_offsets){
+#if defined(__AVX512F__)
+    // The masked form with a zeroed source since GCC warns that the unmasked 
+    // one reads an uninitialized register
+    return reinterpret_cast<v8_u64>(_mm512_mask_i64gather_epi64(
+      _mm512_setzero_si512(), 0xff, reinterpret_cast<__m512i>(byte_offsets), 
+      base, 1));
+#elif defined(__AVX2__)
+    const long long int* b = reinterpret_cast<const long long int*>(base);
+    __m256i idx[2];
+    memcpy(idx, &byte_offsets, sizeof(byte_offsets));
+    idx[0] = _mm256_i64gather_epi64(b, idx[0], 1);
+    idx[1] = _mm256_i64gather_epi64(b, idx[1], 1);
+    v8_u64 words;
+    memcpy(&words, idx, sizeof(words));
+    return words;
+#else
+    const uint8_t* b = reinterpret_cast<const uint8_t*>(base);
+    v8_u64 words;
+    for(uint32_t i = 0; i < v8_lanes; i++){
+      uint64_t word;
+      memcpy(&word, b + byte_offsets[i], sizeof(word));
+      words[i] = word;
+    }
+    return words;
+#endif
+  }
+
+  // Returns a mask where bit i is set iff byte i of the 64-byte line equals 
+  // value.  line does not need to be aligned.
+  INLINE uint64_t match_bytes64(const void* line, uint8_t value){
+#if defined(__AVX512BW__)
+    __m512i haystack = _mm512_loadu_si512(line);
+    return _mm512_cmpeq_epi8_mask(haystack, _mm512_set1_epi8(value));
+#elif defined(__AVX2__)
+    const __m256i needle = _mm256_set1_epi8(value);
+    const __m256i* half = reinterpret_cast<const __m256i*>(line);
+    uint64_t lo = static_cast<uint32_t>(_mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(_mm256_loadu_si256(half), needle)));
+    uint64_t hi = static_cast<uint32_t>(_mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(_mm256_loadu_si256(half + 1), needle)));
+    return lo | (hi << 32);
+#else
+    uint8_t bytes[simd_line_size_bytes];
+    memcpy(bytes, line, simd_line_size_bytes);
+    uint64_t mask = 0;
+    for(uint64_t i = 0; i < simd_line_size_bytes; i++){
+      mask |= static_cast<uint64_t>(bytes[i] == value) << i;
+    }
+    return mask;
+#endif
+  }
+
+  // Returns a mask where bit i is set iff 16-bit word i of the 64-byte line 
+  // equals value.  line does not need to be aligned.
+  INLINE uint32_t match_words64(const void* line, uint16_t value){
+#if defined(__AVX512BW__)
+    __m512i haystack = _mm512_loadu_si512(line);
+    return _mm512_cmpeq_epi16_mask(haystack, _mm512_set1_epi16(value));
+#elif defined(__AVX2__)
+    const __m256i needle = _mm256_set1_epi16(value);
+    const __m256i* half = reinterpret_cast<const __m256i*>(line);
+    __m256i lo = _mm256_cmpeq_epi16(_mm256_loadu_si256(half), needle);
+    __m256i hi = _mm256_cmpeq_epi16(_mm256_loadu_si256(half + 1), needle);
+    // Narrow each 16-bit lane to a byte.  The pack interleaves the 128-bit 
+    // halves of its inputs, so the permute restores the original lane order.
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(lo, hi), 
+      0xD8);
+    return static_cast<uint32_t>(_mm256_movemask_epi8(packed));
+#else
+    uint16_t words[simd_line_size_bytes / 2];
+    memcpy(words, line, simd_line_size_bytes);
+    uint32_t mask = 0;
+    for(uint32_t i = 0; i < simd_line_size_bytes / 2; i++){
+      mask |= static_cast<uint32_t>(words[i] == value) << i;
+    }
+    return mask;
+#endif
+  }
+}
+
+#endif // End of file guards
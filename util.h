@@ -44,6 +44,8 @@ How To Cite:
 
 #include <iostream>
 
+#include <unistd.h>
+
 #include "vector_types.h"
 
 // FIXME: Put guards around this
@@ -104,10 +106,39 @@ namespace util{
   template<class TN, class T> 
   inline TN fast_mod_alternativeN(TN raw_hashes, T modulus);
 
+  // Returns the size in bytes of the level 1 (data), 2, or 3 cache as 
+  // reported by sysconf, or default_size if it doesn't know.
+  inline uint64_t detect_cache_size_bytes(uint32_t level, 
+    uint64_t default_size){
+    long size = -1;
+    switch(level){
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+      case 1: size = sysconf(_SC_LEVEL1_DCACHE_SIZE); break;
+#endif
+#ifdef _SC_LEVEL2_CACHE_SIZE
+      case 2: size = sysconf(_SC_LEVEL2_CACHE_SIZE); break;
+#endif
+#ifdef _SC_LEVEL3_CACHE_SIZE
+      case 3: size = sysconf(_SC_LEVEL3_CACHE_SIZE); break;
+#endif
+      default: break;
+    }
+    return size > 0 ? static_cast<uint64_t>(size) : default_size;
+  }
+
+  // Marsaglia's xorshift64 generator with Vigna's multiplicative output 
+  // scrambling (xorshift64*).  state must not be 0.
+  inline uint64_t xorshift64star(uint64_t& state){
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dULL;
+  }
+
 	template<class ARRAY_TYPE>
 	inline void print_array(const std::string& name, const ARRAY_TYPE& array){
 		std::cout << name << " [ ";
-    for(uint32_t i = 0; i < batch_size; i++){
+    for(uint32_t i = 0; i < array.size(); i++){
       std::cout << static_cast<uint32_t>(array[i]) << " ";
 		}
 		std::cout << "]\n";
@@ -122,6 +153,54 @@ namespace util{
     return raw_hashes;
   }
 
+  // Vectorized fast_mod_alternative for hashes that are narrower than the 
+  // lanes.  Like the scalar version, it requires that every lane of raw_hashes 
+  // is less than 2^hash_width_in_bits.  The generic version works lane by lane.
+  template<class TN, class T> 
+  inline TN fast_mod_alternativeN(TN raw_hashes, T modulus, 
+    T hash_width_in_bits){
+    for(uint32_t i = 0; i < sizeof(TN) / sizeof(T); i++){
+      raw_hashes[i] = fast_mod_alternative<T>(raw_hashes[i], modulus, 
+        hash_width_in_bits);
+    }
+    return raw_hashes;
+  }
+
+  // x86 has no SIMD instruction for the upper half of a 64 x 64-bit multiply, 
+  // so the product is assembled from 32 x 32 -> 64-bit partial products, 
+  // which compile to VPMULUDQ on SSE2, AVX2, and AVX-512.  When the modulus 
+  // fits in 32 bits (fewer than 2^32 buckets) two partial products suffice.
+  template<>
+  inline vH_u64 fast_mod_alternativeN<vH_u64, uint64_t>(vH_u64 raw_hashes, 
+    uint64_t modulus, uint64_t hash_width_in_bits){
+    constexpr uint64_t low_mask = 0xffffffffULL;
+    const vH_u64 a_lo = raw_hashes & low_mask;
+    const vH_u64 a_hi = raw_hashes >> 32;
+    if(modulus <= low_mask && hash_width_in_bits >= 32 && 
+      hash_width_in_bits < 64){
+      // a_hi * modulus < 2^hash_width_in_bits, so nothing overflows
+      return ((a_hi * modulus) + ((a_lo * modulus) >> 32)) >> 
+        (hash_width_in_bits - 32);
+    }
+    const uint64_t b_lo = modulus & low_mask;
+    const uint64_t b_hi = modulus >> 32;
+    const vH_u64 lo_lo = a_lo * b_lo;
+    const vH_u64 lo_hi = a_lo * b_hi;
+    const vH_u64 hi_lo = a_hi * b_lo;
+    const vH_u64 hi_hi = a_hi * b_hi;
+    // Sum of the middle 32-bit columns.  It fits in 34 bits so can't overflow.
+    const vH_u64 middle = (lo_lo >> 32) + (lo_hi & low_mask) + 
+      (hi_lo & low_mask);
+    const vH_u64 product_lo = (middle << 32) | (lo_lo & low_mask);
+    const vH_u64 product_hi = hi_hi + (lo_hi >> 32) + (hi_lo >> 32) + 
+      (middle >> 32);
+    if(hash_width_in_bits >= 64){
+      return product_hi >> (hash_width_in_bits - 64);
+    }
+    return (product_hi << (64 - hash_width_in_bits)) | 
+      (product_lo >> hash_width_in_bits);
+  }
+
 } // End of util namespace
 
 
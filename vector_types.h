@@ -71,6 +71,9 @@ struct StoreParams{ // TODO: Optimize this a bit
 };
 
 
+// The default batch size.  Each CompressedCuckooFilter can override it with 
+// its t_batch_size template parameter and then uses its own copies of the 
+// batch-sized array types below.
 constexpr uint_fast64_t batch_size = 128;
 typedef std::array<atom_t, batch_size> ar_atom;
 typedef std::array<uint8_t, batch_size> ar_u8;
@@ -80,6 +83,9 @@ typedef std::array<counter_t, batch_size> ar_counter;
 typedef std::array<hash_t, batch_size> ar_hash;
 typedef std::array<keys_t, batch_size> ar_key;
 typedef std::array<StoreParams, batch_size> ar_store_params;
+// Per-batch results of lookups, one bit per key.  See batch_output.h.
+constexpr uint_fast64_t batch_bitmap_words = (batch_size + 63) / 64;
+typedef std::array<uint64_t, batch_bitmap_words> ar_bitmap;
 
 struct StoreParamsSOA{
   ar_hash block_ids;
@@ -99,6 +105,14 @@ typedef atom_t vN_atom __attribute__ ((vector_size (sizeof(atom_t) * _N)));
 typedef keys_t vN_key __attribute__((vector_size (sizeof(keys_t) * _N)));
 typedef hash_t vN_hash __attribute__((vector_size (sizeof(hash_t) * _N)));
 
+// Batch hashing (hash_many) uses 512-bit vectors regardless of _N.  GCC splits
+// vectors that are wider than the hardware's into several registers, so even 
+// on AVX2 this gives the core more independent multiply chains to overlap.
+constexpr uint64_t _HASH_N = 64 / sizeof(hash_t);
+typedef uint64_t vH_u64 __attribute__((vector_size(sizeof(uint64_t) * _HASH_N)));
+typedef keys_t vH_key __attribute__((vector_size(sizeof(keys_t) * _HASH_N)));
+typedef hash_t vH_hash __attribute__((vector_size(sizeof(hash_t) * _HASH_N)));
+
 // For some reason using atom_t for counters in the vectorized case is faster.
 typedef atom_t vN_counter __attribute__ ((vector_size (sizeof(atom_t) * _N)));
 